@@ -3,10 +3,14 @@
 #include <debug.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -32,6 +36,7 @@
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -47,6 +52,65 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4          /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /* SET MULTIPLE MODE. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* Upper bound on the number of sectors moved per DRQ block by
+   READ/WRITE MULTIPLE, set with -mult.  The block size actually
+   used is the largest power of two within this bound that the
+   device reports in IDENTIFY DEVICE.  0 disables multiple mode,
+   leaving one interrupt per sector. */
+unsigned disk_multiple_max = 16;
+
+/* Bus master IDE (SFF-8038i), as in the PIIX emulated by QEMU.
+   Its registers are found through BAR 4 of the controller's PCI
+   configuration space, 8 ports per channel.  The controller
+   moves the data of a READ DMA or WRITE DMA command to or from
+   the physical regions listed in a PRD table, then interrupts
+   once.  Without a bus master, or for a buffer it cannot reach,
+   the PIO path below is used. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0)  /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)   /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)     /* PRD table. */
+
+/* Bus master Command Register bits. */
+#define BM_CMD_START 0x01       /* Start transfer. */
+#define BM_CMD_READ 0x08        /* Device to memory. */
+
+/* Bus master Status Register bits.  ERR and IRQ clear when 1 is
+   written to them. */
+#define BM_STA_ACTIVE 0x01      /* Transfer in progress. */
+#define BM_STA_ERR 0x02         /* Transfer failed. */
+#define BM_STA_IRQ 0x04         /* Device interrupted. */
+
+/* Physical Region Descriptor.  A region must not cross a 64 kB
+   boundary; a byte count of 0 means 64 kB. */
+struct prd {
+	uint32_t addr;              /* Physical address. */
+	uint16_t size;              /* Byte count. */
+	uint16_t flags;             /* PRD_EOT on the last entry. */
+};
+#define PRD_EOT 0x8000
+
+/* Requests merged into one command: at most DISK_MERGE_MAX of
+   them, DISK_CMD_MAX sectors in all. */
+#define DISK_MERGE_MAX 16
+#define DISK_CMD_MAX 256
+
+/* Enough regions for DISK_MERGE_MAX requests, each split at no
+   more than two 64 kB boundaries. */
+#define PRD_CNT (3 * DISK_MERGE_MAX)
+
+/* PCI configuration space access, mechanism #1. */
+#define PCI_CONFIG_ADDR 0xcf8
+#define PCI_CONFIG_DATA 0xcfc
+#define PCI_REG_COMMAND 0x04
+#define PCI_REG_CLASS 0x08
+#define PCI_REG_BAR4 0x20
+#define PCI_CMD_MASTER 0x04     /* Bus master enable. */
 
 /* An ATA device. */
 struct disk {
@@ -56,6 +120,8 @@ struct disk {
 
 	bool is_ata;                /* 1=This device is an ATA disk. */
 	disk_sector_t capacity;     /* Capacity in sectors (if is_ata). */
+	uint8_t multiple;           /* Sectors per DRQ block for READ/WRITE
+								   MULTIPLE, 0 if unsupported. */
 
 	long long read_cnt;         /* Number of sectors read. */
 	long long write_cnt;        /* Number of sectors written. */
@@ -68,23 +134,43 @@ struct channel {
 	uint16_t reg_base;          /* Base I/O port. */
 	uint8_t irq;                /* Interrupt in use. */
 
-	struct lock lock;           /* Must acquire to access the controller. */
+	struct lock lock;           /* Protects QUEUE and HEAD. */
+	struct condition queued;    /* Signaled when QUEUE gains a request. */
+	struct list queue;          /* Pending requests, in C-LOOK order. */
+	uint64_t head;              /* Position after the last request run. */
+	long long merge_cnt;        /* Requests merged into another's command. */
+
 	bool expecting_interrupt;   /* True if an interrupt is expected, false if
 								   any interrupt would be spurious. */
 	struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
+	uint16_t bm_base;           /* Bus master registers, 0 if no DMA. */
+	struct prd *prdt;           /* PRD table for bus master transfers. */
+
 	struct disk devices[2];     /* The devices on this channel. */
 };
 
 /* We support the two "legacy" ATA channels found in a standard PC. */
 #define CHANNEL_CNT 2
 static struct channel channels[CHANNEL_CNT];
+static struct prd prd_tables[CHANNEL_CNT][PRD_CNT]
+	__attribute__ ((aligned (512)));
 
 static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
 
-static void select_sector (struct disk *, disk_sector_t);
+static void set_multiple_mode (struct disk *, uint8_t max);
+static uint16_t find_bus_master (void);
+
+static void channel_dispatcher (void *channel);
+static void dispatch_batch (struct channel *, struct list *batch);
+static bool dma_batch (struct channel *, struct list *batch);
+static void pio_batch (struct channel *, struct list *batch);
+static void disk_sync (struct disk *, disk_sector_t, void *, size_t cnt,
+		bool write);
+
+static void select_sectors (struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -99,6 +185,7 @@ static void interrupt_handler (struct intr_frame *);
 /* Initialize the disk subsystem and detect disks. */
 void
 disk_init (void) {
+	uint16_t bm_base = find_bus_master ();
 	size_t chan_no;
 
 	for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++) {
@@ -120,8 +207,14 @@ disk_init (void) {
 				NOT_REACHED ();
 		}
 		lock_init (&c->lock);
+		cond_init (&c->queued);
+		list_init (&c->queue);
+		c->head = 0;
+		c->merge_cnt = 0;
 		c->expecting_interrupt = false;
 		sema_init (&c->completion_wait, 0);
+		c->bm_base = bm_base != 0 ? bm_base + chan_no * 8 : 0;
+		c->prdt = prd_tables[chan_no];
 
 		/* Initialize devices. */
 		for (dev_no = 0; dev_no < 2; dev_no++) {
@@ -132,6 +225,7 @@ disk_init (void) {
 
 			d->is_ata = false;
 			d->capacity = 0;
+			d->multiple = 0;
 
 			d->read_cnt = d->write_cnt = 0;
 		}
@@ -150,6 +244,10 @@ disk_init (void) {
 		for (dev_no = 0; dev_no < 2; dev_no++)
 			if (c->devices[dev_no].is_ata)
 				identify_ata_device (&c->devices[dev_no]);
+
+		/* From here on only the dispatcher touches the hardware. */
+		if (c->devices[0].is_ata || c->devices[1].is_ata)
+			thread_create (c->name, PRI_MAX, channel_dispatcher, c);
 	}
 
 	/* DO NOT MODIFY BELOW LINES. */
@@ -170,6 +268,9 @@ disk_print_stats (void) {
 				printf ("%s: %lld reads, %lld writes\n",
 						d->name, d->read_cnt, d->write_cnt);
 		}
+		if (channels[chan_no].merge_cnt > 0)
+			printf ("%s: %lld requests merged\n",
+					channels[chan_no].name, channels[chan_no].merge_cnt);
 	}
 }
 
@@ -209,21 +310,7 @@ disk_size (struct disk *d) {
    per-disk locking is unneeded. */
 void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
-	struct channel *c;
-
-	ASSERT (d != NULL);
-	ASSERT (buffer != NULL);
-
-	c = d->channel;
-	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-	sema_down (&c->completion_wait);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-	input_sector (c, buffer);
-	d->read_cnt++;
-	lock_release (&c->lock);
+	disk_sync (d, sec_no, buffer, 1, false);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -233,23 +320,229 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
    per-disk locking is unneeded. */
 void
 disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
+	disk_sync (d, sec_no, (void *) buffer, 1, true);
+}
+
+/* Request queue.
+
+   Each channel keeps the requests submitted to its disks in a
+   queue sorted by device and sector, and a dispatcher thread
+   that alone drives the hardware.  The dispatcher serves the
+   queue in C-LOOK order: the first request at or after the
+   position where the last one ended, wrapping around to the
+   lowest one.  Requests that follow it exactly on the disk, in
+   the same direction, are merged into the same command.  The
+   completion callbacks then run in the dispatcher thread.
+   Requests that overlap are not ordered with respect to each
+   other; a caller that needs ordering waits for completion. */
+
+/* C-LOOK sort key of R. */
+static uint64_t
+request_key (const struct disk_request *r) {
+	return (uint64_t) r->disk->dev_no << 32 | r->sector;
+}
+
+static bool
+request_less (const struct list_elem *a, const struct list_elem *b,
+		void *aux UNUSED) {
+	return request_key (list_entry (a, struct disk_request, elem))
+		< request_key (list_entry (b, struct disk_request, elem));
+}
+
+/* Queues R for its disk and returns at once.  R->complete (R)
+   is called from the channel's dispatcher thread once the
+   transfer is done; R must stay valid until then.  R->buffer
+   must be a kernel address, since the transfer does not run in
+   the submitter's address space. */
+void
+disk_submit (struct disk_request *r) {
 	struct channel *c;
 
-	ASSERT (d != NULL);
-	ASSERT (buffer != NULL);
+	ASSERT (r != NULL && r->disk != NULL);
+	ASSERT (r->cnt > 0 && r->cnt <= DISK_CMD_MAX);
+	ASSERT (is_kernel_vaddr (r->buffer));
 
-	c = d->channel;
+	c = r->disk->channel;
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-	output_sector (c, buffer);
-	sema_down (&c->completion_wait);
-	d->write_cnt++;
+	list_insert_ordered (&c->queue, &r->elem, request_less, NULL);
+	cond_signal (&c->queued, &c->lock);
 	lock_release (&c->lock);
 }
-
+
+static void
+disk_sync_complete (struct disk_request *r) {
+	sema_up (r->aux);
+}
+
+/* Submits a request and waits for it.  A user BUFFER, which the
+   dispatcher cannot reach, goes through a bounce buffer. */
+static void
+disk_sync (struct disk *d, disk_sector_t sec_no, void *buffer, size_t cnt,
+		bool write) {
+	struct disk_request r;
+	struct semaphore done;
+	void *bounce = NULL;
+
+	ASSERT (d != NULL);
+	ASSERT (buffer != NULL);
+
+	if (!is_kernel_vaddr (buffer)) {
+		bounce = malloc (cnt * DISK_SECTOR_SIZE);
+		if (bounce == NULL)
+			PANIC ("%s: no memory for a bounce buffer", d->name);
+		if (write)
+			memcpy (bounce, buffer, cnt * DISK_SECTOR_SIZE);
+	}
+
+	sema_init (&done, 0);
+	r.disk = d;
+	r.sector = sec_no;
+	r.cnt = cnt;
+	r.buffer = bounce != NULL ? bounce : buffer;
+	r.write = write;
+	r.complete = disk_sync_complete;
+	r.aux = &done;
+	disk_submit (&r);
+	sema_down (&done);
+
+	if (bounce != NULL) {
+		if (!write)
+			memcpy (buffer, bounce, cnt * DISK_SECTOR_SIZE);
+		free (bounce);
+	}
+}
+
+/* Moves the next requests of C's queue, in C-LOOK order, into
+   BATCH.  The caller must hold C's lock. */
+static void
+take_batch (struct channel *c, struct list *batch) {
+	struct list_elem *e;
+	struct disk_request *first, *last;
+	size_t cnt, merged;
+
+	for (e = list_begin (&c->queue); e != list_end (&c->queue); e = list_next (e))
+		if (request_key (list_entry (e, struct disk_request, elem)) >= c->head)
+			break;
+	if (e == list_end (&c->queue))
+		e = list_begin (&c->queue);
+
+	first = last = list_entry (e, struct disk_request, elem);
+	cnt = first->cnt;
+	e = list_remove (e);
+	list_push_back (batch, &first->elem);
+
+	for (merged = 1; merged < DISK_MERGE_MAX && e != list_end (&c->queue);
+			merged++) {
+		struct disk_request *r = list_entry (e, struct disk_request, elem);
+		if (r->disk != first->disk || r->write != first->write
+				|| r->sector != last->sector + last->cnt
+				|| cnt + r->cnt > DISK_CMD_MAX)
+			break;
+		e = list_remove (e);
+		list_push_back (batch, &r->elem);
+		cnt += r->cnt;
+		last = r;
+		c->merge_cnt++;
+	}
+	c->head = request_key (last) + last->cnt;
+}
+
+/* Dispatcher thread of channel C_. */
+static void
+channel_dispatcher (void *c_) {
+	struct channel *c = c_;
+	struct list batch;
+
+	for (;;) {
+		list_init (&batch);
+		lock_acquire (&c->lock);
+		while (list_empty (&c->queue))
+			cond_wait (&c->queued, &c->lock);
+		take_batch (c, &batch);
+		lock_release (&c->lock);
+
+		dispatch_batch (c, &batch);
+		while (!list_empty (&batch)) {
+			struct disk_request *r = list_entry (list_pop_front (&batch),
+					struct disk_request, elem);
+			if (r->complete != NULL)
+				r->complete (r);
+		}
+	}
+}
+
+/* Runs BATCH, consecutive requests for one disk, as one
+   command. */
+static void
+dispatch_batch (struct channel *c, struct list *batch) {
+	struct list_elem *e;
+	struct disk_request *first = list_entry (list_front (batch),
+			struct disk_request, elem);
+	struct disk *d = first->disk;
+	size_t cnt = 0;
+
+	for (e = list_begin (batch); e != list_end (batch); e = list_next (e))
+		cnt += list_entry (e, struct disk_request, elem)->cnt;
+
+	if (!dma_batch (c, batch))
+		pio_batch (c, batch);
+
+	if (first->write)
+		d->write_cnt += cnt;
+	else
+		d->read_cnt += cnt;
+}
+
+/* Runs BATCH in PIO mode, moving each DRQ block sector by
+   sector to or from the request it belongs to. */
+static void
+pio_batch (struct channel *c, struct list *batch) {
+	struct list_elem *e;
+	struct disk_request *first = list_entry (list_front (batch),
+			struct disk_request, elem);
+	struct disk *d = first->disk;
+	bool write = first->write;
+	size_t cnt = 0, block, ofs;
+
+	for (e = list_begin (batch); e != list_end (batch); e = list_next (e))
+		cnt += list_entry (e, struct disk_request, elem)->cnt;
+	block = d->multiple ? d->multiple : 1;
+
+	select_sectors (d, first->sector, cnt);
+	if (write)
+		issue_pio_command (c, d->multiple ? CMD_WRITE_MULTIPLE : CMD_WRITE_SECTOR_RETRY);
+	else
+		issue_pio_command (c, d->multiple ? CMD_READ_MULTIPLE : CMD_READ_SECTOR_RETRY);
+
+	e = list_begin (batch);
+	ofs = 0;
+	while (cnt > 0) {
+		size_t n = cnt < block ? cnt : block;
+		size_t i;
+
+		if (!write)
+			sema_down (&c->completion_wait);
+		if (!wait_while_busy (d))
+			PANIC ("%s: disk %s failed, sector=%"PRDSNu, d->name,
+					write ? "write" : "read", first->sector);
+		for (i = 0; i < n; i++) {
+			struct disk_request *r = list_entry (e, struct disk_request, elem);
+			uint8_t *sector = (uint8_t *) r->buffer + ofs * DISK_SECTOR_SIZE;
+			if (write)
+				output_sector (c, sector);
+			else
+				input_sector (c, sector);
+			if (++ofs == r->cnt) {
+				e = list_next (e);
+				ofs = 0;
+			}
+		}
+		if (write)
+			sema_down (&c->completion_wait);
+		cnt -= n;
+	}
+}
+
 /* Disk detection and identification. */
 
 static void print_ata_string (char *string, size_t size);
@@ -364,6 +657,10 @@ identify_ata_device (struct disk *d) {
 	/* Calculate capacity. */
 	d->capacity = id[60] | ((uint32_t) id[61] << 16);
 
+	/* Word 47 holds the largest DRQ block READ/WRITE MULTIPLE
+	   can use, 0 if the commands are not supported. */
+	set_multiple_mode (d, id[47] & 0xff);
+
 	/* Print identification message. */
 	printf ("%s: detected %'"PRDSNu" sector (", d->name, d->capacity);
 	if (d->capacity > 1024 / DISK_SECTOR_SIZE * 1024 * 1024)
@@ -382,6 +679,133 @@ identify_ata_device (struct disk *d) {
 	printf ("\"\n");
 }
 
+/* Enables READ/WRITE MULTIPLE on disk D with the largest power of
+   two block size that fits both MAX and disk_multiple_max, and
+   records the result in D's multiple member. */
+static void
+set_multiple_mode (struct disk *d, uint8_t max) {
+	struct channel *c = d->channel;
+	uint8_t block = 1;
+
+	d->multiple = 0;
+	if (max == 0 || disk_multiple_max == 0)
+		return;
+	while (block * 2 <= max && block * 2 <= disk_multiple_max)
+		block *= 2;
+
+	select_device_wait (d);
+	outb (reg_nsect (c), block);
+	issue_pio_command (c, CMD_SET_MULTIPLE_MODE);
+	sema_down (&c->completion_wait);
+	wait_while_busy (d);
+	if (!(inb (reg_alt_status (c)) & STA_ERR))
+		d->multiple = block;
+}
+
+/* Reads register REG of PCI function BUS:DEV.FUNC. */
+static uint32_t
+pci_read_config (int bus, int dev, int func, int reg) {
+	outl (PCI_CONFIG_ADDR, 0x80000000 | bus << 16 | dev << 11 | func << 8
+			| (reg & 0xfc));
+	return inl (PCI_CONFIG_DATA);
+}
+
+/* Looks on PCI bus 0 for an IDE controller capable of bus
+   mastering, enables bus mastering on it, and returns the base
+   port of its bus master registers.  Returns 0 if there is
+   none. */
+static uint16_t
+find_bus_master (void) {
+	int dev, func;
+
+	for (dev = 0; dev < 32; dev++)
+		for (func = 0; func < 8; func++) {
+			uint32_t id = pci_read_config (0, dev, func, 0);
+			if ((id & 0xffff) == 0xffff)
+				continue;
+
+			/* Class 01h (mass storage), subclass 01h (IDE),
+			   programming interface bit 7 (bus master). */
+			uint32_t class = pci_read_config (0, dev, func, PCI_REG_CLASS);
+			if ((class >> 16) != 0x0101 || !(class & 0x8000))
+				continue;
+
+			uint32_t bar = pci_read_config (0, dev, func, PCI_REG_BAR4);
+			if (!(bar & 1) || (bar & 0xfffc) == 0)
+				continue;
+
+			uint32_t cmd = pci_read_config (0, dev, func, PCI_REG_COMMAND);
+			outw (PCI_CONFIG_DATA, (cmd & 0xffff) | PCI_CMD_MASTER);
+			return bar & 0xfffc;
+		}
+	return 0;
+}
+
+/* Runs BATCH with a single READ DMA or WRITE DMA command, one
+   or more PRD entries per request.  Returns false, having done
+   nothing, if C has no bus master or some buffer is not in the
+   kernel's direct map below 4 GB; the caller then uses PIO. */
+static bool
+dma_batch (struct channel *c, struct list *batch) {
+	struct list_elem *e;
+	struct disk_request *first = list_entry (list_front (batch),
+			struct disk_request, elem);
+	struct disk *d = first->disk;
+	bool write = first->write;
+	size_t cnt = 0;
+	uint8_t status;
+	int i = 0;
+
+	if (c->bm_base == 0)
+		return false;
+	for (e = list_begin (batch); e != list_end (batch); e = list_next (e)) {
+		struct disk_request *r = list_entry (e, struct disk_request, elem);
+		if (vtop (r->buffer) + r->cnt * DISK_SECTOR_SIZE > 0x100000000ULL)
+			return false;
+		cnt += r->cnt;
+	}
+
+	/* Describe each buffer, which the direct map makes physically
+	   contiguous, in regions that stay within 64 kB. */
+	for (e = list_begin (batch); e != list_end (batch); e = list_next (e)) {
+		struct disk_request *r = list_entry (e, struct disk_request, elem);
+		uint64_t addr = vtop (r->buffer);
+		size_t size = r->cnt * DISK_SECTOR_SIZE;
+
+		while (size > 0) {
+			size_t chunk = 0x10000 - (addr & 0xffff);
+			if (chunk > size)
+				chunk = size;
+			ASSERT (i < PRD_CNT);
+			c->prdt[i].addr = addr;
+			c->prdt[i].size = chunk & 0xffff;
+			c->prdt[i].flags = 0;
+			addr += chunk;
+			size -= chunk;
+			i++;
+		}
+	}
+	c->prdt[i - 1].flags = PRD_EOT;
+
+	outl (reg_bm_prdt (c), vtop (c->prdt));
+	outb (reg_bm_command (c), write ? 0 : BM_CMD_READ);
+	outb (reg_bm_status (c), inb (reg_bm_status (c)) | BM_STA_ERR | BM_STA_IRQ);
+
+	select_sectors (d, first->sector, cnt);
+	issue_pio_command (c, write ? CMD_WRITE_DMA : CMD_READ_DMA);
+	outb (reg_bm_command (c), inb (reg_bm_command (c)) | BM_CMD_START);
+	sema_down (&c->completion_wait);
+
+	outb (reg_bm_command (c), inb (reg_bm_command (c)) & ~BM_CMD_START);
+	status = inb (reg_bm_status (c));
+	outb (reg_bm_status (c), status | BM_STA_ERR | BM_STA_IRQ);
+	if ((status & (BM_STA_ERR | BM_STA_ACTIVE))
+			|| (inb (reg_alt_status (c)) & STA_ERR))
+		PANIC ("%s: disk %s failed, sector=%"PRDSNu, d->name,
+				write ? "write" : "read", first->sector);
+	return true;
+}
+
 /* Prints STRING, which consists of SIZE bytes in a funky format:
    each pair of bytes is in reverse order.  Does not print
    trailing whitespace and/or nulls. */
@@ -402,17 +826,19 @@ print_ata_string (char *string, size_t size) {
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and CNT to the disk's sector selection and
+   count registers.  (We use LBA mode.)  A count of 256 is
+   written as 0, as ATA specifies. */
 static void
-select_sector (struct disk *d, disk_sector_t sec_no) {
+select_sectors (struct disk *d, disk_sector_t sec_no, size_t cnt) {
 	struct channel *c = d->channel;
 
-	ASSERT (sec_no < d->capacity);
-	ASSERT (sec_no < (1UL << 28));
+	ASSERT (cnt > 0 && cnt <= 256);
+	ASSERT (sec_no + cnt <= d->capacity);
+	ASSERT (sec_no + cnt <= (1UL << 28));
 
 	select_device_wait (d);
-	outb (reg_nsect (c), 1);
+	outb (reg_nsect (c), cnt & 0xff);
 	outb (reg_lbal (c), sec_no);
 	outb (reg_lbam (c), sec_no >> 8);
 	outb (reg_lbah (c), (sec_no >> 16));
@@ -445,7 +871,7 @@ static void
 output_sector (struct channel *c, const void *sector) {
 	outsw (reg_data (c), sector, DISK_SECTOR_SIZE / 2);
 }
-
+
 /* Low-level ATA primitives. */
 
 /* Wait up to 10 seconds for the controller to become idle, that
@@ -20,11 +20,31 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* 8254 input clock cycles per timer tick. */
+static uint16_t tick_count;
+
+/* Tickless idle.  While only the idle thread is runnable the PIT
+   is reprogrammed to interrupt once every IDLE_PERIOD ticks
+   instead of every tick; the skipped ticks are accounted when that
+   interrupt arrives or when another interrupt ends the idle period
+   early.  IDLE_RESIDUE carries the fractions of a tick that the
+   reprogramming would otherwise lose: the part of the current tick
+   already elapsed on entry, and the part left over by an early
+   end.  A 16-bit counter covers at most IDLE_MAX ticks. */
+#define IDLE_MAX (0xffff / tick_count)
+static int64_t idle_period;
+static unsigned idle_residue;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
 static intr_handler_func timer_interrupt;
+static void pit_program (uint16_t count);
+static uint16_t pit_read (void);
+static bool pit_pending (void);
+static void mlfqs_update (void);
+static void skip_ticks (int64_t n);
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
@@ -36,11 +56,8 @@ void
 timer_init (void) {
 	/* 8254 input frequency divided by TIMER_FREQ, rounded to
 	   nearest. */
-	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
-
-	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-	outb (0x40, count & 0xff);
-	outb (0x40, count >> 8);
+	tick_count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
+	pit_program (tick_count);
 
 	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
@@ -133,29 +150,139 @@ timer_print_stats (void) {
 	printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
 }
 
+/* Called by the idle thread, with interrupts off, when nothing
+   else is runnable.  Stretches the timer period up to the tick at
+   which the next sleeper is due. */
+void
+timer_idle_enter (void) {
+  int64_t next = thread_next_wakeup ();
+  int64_t period = next - ticks < IDLE_MAX ? next - ticks : IDLE_MAX;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (idle_period != 0 || period <= 1 || pit_pending ())
+    return;
+
+  /* Keep the part of the current tick that has already run. */
+  idle_residue += tick_count - pit_read ();
+  idle_period = period;
+  pit_program (period * tick_count);
+}
+
+/* Ticks to account for an idle period that ran out, besides the
+   one its interrupt counts, with whole ticks of IDLE_RESIDUE. */
+static int64_t
+idle_period_ticks (void) {
+  int64_t n = idle_period - 1 + idle_residue / tick_count;
+
+  idle_residue %= tick_count;
+  return n;
+}
+
+/* Called by the scheduler, with interrupts off, when it switches
+   away from the idle thread.  If the idle period is still running,
+   accounts the ticks that really elapsed and restores the normal
+   timer rate. */
+void
+timer_idle_exit (void) {
+  int64_t elapsed;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (idle_period == 0)
+    return;
+
+  if (pit_pending ())
+    /* The period ran out; the pending interrupt counts its last
+       tick. */
+    elapsed = idle_period_ticks ();
+  else {
+    unsigned cycles = idle_period * tick_count - pit_read () + idle_residue;
+    elapsed = cycles / tick_count;
+    idle_residue = cycles % tick_count;
+  }
+
+  idle_period = 0;
+  pit_program (tick_count);
+  skip_ticks (elapsed);
+}
+
 /* Timer interrupt handler. */
 //! 타이머 인터럽트 핸들러 : 스레드와 커널의 ticks를 매 틱마다 증가시킴
 static void
 timer_interrupt (struct intr_frame *args UNUSED) {
+  if (idle_period != 0) {
+    /* End of an idle period: account all of its ticks but the
+       last, which is this one. */
+    skip_ticks (idle_period_ticks ());
+    idle_period = 0;
+    pit_program (tick_count);
+  }
+
   ticks++;
 	thread_tick ();
 
   if (thread_mlfqs) {
     if (strcmp(thread_current ()->name, "idle"))
       thread_current ()->recent_cpu += (1<<14);
-
-    if (timer_ticks () % TIMER_FREQ == 0) {
-      thread_calc_load_avg ();                      //* 전역변수인 load_avg 갱신 필요
-      thread_calc_recent_cpu ();                    //* 모든 스레드의 recent_cpu 갱신 필요
-    }
-    
-    if (timer_ticks () % 4 == 0)
-      thread_calc_priority ();                      //* 모든 스레드의 우선순위 갱신
+    mlfqs_update ();
   }
 
   thread_wakeup (ticks);                            // ticks 마다, 스레드를 확인하여 깨울 스레드가 존재하는 지 확인
 }
 
+/* MLFQS bookkeeping due at the current tick. */
+static void
+mlfqs_update (void) {
+  if (ticks % TIMER_FREQ == 0) {
+    thread_calc_load_avg ();                        //* 전역변수인 load_avg 갱신 필요
+    thread_calc_recent_cpu ();                      //* 모든 스레드의 recent_cpu 갱신 필요
+  }
+
+  if (ticks % 4 == 0)
+    thread_calc_priority ();                        //* 모든 스레드의 우선순위 갱신
+}
+
+/* Advances the clock by N ticks during which only the idle thread
+   ran: nobody's recent_cpu grows, but load_avg and recent_cpu
+   still decay at every second boundary crossed. */
+static void
+skip_ticks (int64_t n) {
+  thread_idle_ticks (n);
+  while (n-- > 0) {
+    ticks++;
+    if (thread_mlfqs)
+      mlfqs_update ();
+    thread_wakeup (ticks);
+  }
+}
+
+/* Starts counter 0 counting down from COUNT, interrupting every
+   COUNT input clock cycles. */
+static void
+pit_program (uint16_t count) {
+	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
+	outb (0x40, count & 0xff);
+	outb (0x40, count >> 8);
+}
+
+/* Returns the current value of counter 0. */
+static uint16_t
+pit_read (void) {
+	uint8_t lo, hi;
+
+	outb (0x43, 0x00);    /* CW: latch counter 0. */
+	lo = inb (0x40);
+	hi = inb (0x40);
+	return lo | (hi << 8);
+}
+
+/* Returns true if the timer has raised an interrupt that is still
+   waiting in the master PIC's request register. */
+static bool
+pit_pending (void) {
+	outb (0x20, 0x0a);    /* OCW3: read IRR. */
+	return inb (0x20) & 1;
+}
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool
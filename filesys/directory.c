@@ -5,6 +5,11 @@
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+#include <hash.h>
+#ifdef EFILESYS
+#include "filesys/fat.h"
+#endif
 
 /* A directory. */
 struct dir {
@@ -12,20 +17,119 @@ struct dir {
 	off_t pos;                          /* Current position. */
 };
 
+/* A directory is an open-addressed hash table of entries.  NAME lives in
+ * the first slot that is not in use, starting at its home slot
+ * hash (NAME) % slot count and probing forward, and always within
+ * DIR_PROBE_MAX slots of home, so a lookup reads a bounded number of
+ * entries.  A directory whose probe runs are full doubles and
+ * rehashes. */
+#define DIR_PROBE_MAX 8
+#define DIR_MIN_SLOTS 16
+
+/* Slot states.  A deleted slot can be reused but does not end a probe
+ * run the way a free one does. */
+#define DIRENT_FREE 0
+#define DIRENT_USED 1
+#define DIRENT_DELETED 2
+
 /* A single directory entry. */
 struct dir_entry {
 	disk_sector_t inode_sector;         /* Sector number of header. */
 	char name[NAME_MAX + 1];            /* Null terminated file name. */
-	bool in_use;                        /* In use or free? */
+	uint8_t state;                      /* DIRENT_FREE, _USED or _DELETED. */
+};
+
+/* Lookups, additions and removals in a directory run under the
+ * directory inode's inode_lock(), so a probe run is never seen half
+ * updated and the dentry cache never records a stale result.  Distinct
+ * directories, and file data, are not serialized by it. */
+
+/* Dentry cache: the result of recent lookups, keyed by the directory's
+ * inode sector and the name.  A negative entry (INODE_SECTOR 0, no file
+ * has its inode there) records a name that does not exist.  The cache
+ * is direct mapped; a colliding insert replaces the old entry. */
+#define DCACHE_SIZE 128
+
+struct dcache_entry {
+	bool valid;
+	disk_sector_t dir_sector;           /* Directory searched. */
+	char name[NAME_MAX + 1];
+	disk_sector_t inode_sector;         /* 0 for a negative entry. */
 };
 
+static struct dcache_entry dcache[DCACHE_SIZE];
+static struct lock dcache_lock;
+
+static long long dcache_hit_cnt;
+static long long dcache_miss_cnt;
+
+static struct dcache_entry *
+dcache_slot (disk_sector_t dir_sector, const char *name) {
+	return &dcache[(hash_string (name) ^ hash_int (dir_sector)) % DCACHE_SIZE];
+}
+
+/* Looks NAME up in the dentry cache of DIR_SECTOR.  Returns true on a
+ * hit and stores the inode sector, 0 if negative, in *SECTORP. */
+static bool
+dcache_lookup (disk_sector_t dir_sector, const char *name,
+		disk_sector_t *sectorp) {
+	bool hit = false;
+
+	lock_acquire (&dcache_lock);
+	struct dcache_entry *d = dcache_slot (dir_sector, name);
+	if (d->valid && d->dir_sector == dir_sector && !strcmp (d->name, name)) {
+		*sectorp = d->inode_sector;
+		hit = true;
+		dcache_hit_cnt++;
+	}
+	else
+		dcache_miss_cnt++;
+	lock_release (&dcache_lock);
+	return hit;
+}
+
+/* Records that NAME in DIR_SECTOR has its inode at SECTOR, or does not
+ * exist if SECTOR is 0. */
+static void
+dcache_insert (disk_sector_t dir_sector, const char *name,
+		disk_sector_t sector) {
+	lock_acquire (&dcache_lock);
+	struct dcache_entry *d = dcache_slot (dir_sector, name);
+	d->valid = true;
+	d->dir_sector = dir_sector;
+	strlcpy (d->name, name, sizeof d->name);
+	d->inode_sector = sector;
+	lock_release (&dcache_lock);
+}
+
+/* Initializes the dentry cache. */
+void
+dir_init (void) {
+	lock_init (&dcache_lock);
+}
+
+/* Prints dentry cache statistics. */
+void
+dir_print_stats (void) {
+	printf ("Dentry cache: %lld hits, %lld misses\n",
+			dcache_hit_cnt, dcache_miss_cnt);
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
  * given SECTOR.  Returns true if successful, false on failure. */
 bool
 dir_create (disk_sector_t sector, size_t entry_cnt) {
+	if (entry_cnt < DIR_MIN_SLOTS)
+		entry_cnt = DIR_MIN_SLOTS;
 	return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
 }
 
+/* Returns the number of entry slots in DIR. */
+static size_t
+dir_slot_cnt (const struct dir *dir) {
+	return inode_length (dir->inode) / sizeof (struct dir_entry);
+}
+
 /* Opens and returns the directory for the given INODE, of which
  * it takes ownership.  Returns a null pointer on failure. */
 struct dir *
@@ -46,7 +150,11 @@ dir_open (struct inode *inode) {
  * Return true if successful, false on failure. */
 struct dir *
 dir_open_root (void) {
+#ifdef EFILESYS
+	return dir_open (inode_open (cluster_to_sector (ROOT_DIR_CLUSTER)));
+#else
 	return dir_open (inode_open (ROOT_DIR_SECTOR));
+#endif
 }
 
 /* Opens and returns a new directory for the same inode as DIR.
@@ -80,23 +188,89 @@ static bool
 lookup (const struct dir *dir, const char *name,
 		struct dir_entry *ep, off_t *ofsp) {
 	struct dir_entry e;
-	size_t ofs;
+	size_t slots = dir_slot_cnt (dir);
+	size_t i;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-			ofs += sizeof e)
-		if (e.in_use && !strcmp (name, e.name)) {
+	if (slots == 0)
+		return false;
+	size_t home = hash_string (name) % slots;
+	for (i = 0; i < DIR_PROBE_MAX && i < slots; i++) {
+		off_t ofs = (home + i) % slots * sizeof e;
+		if (inode_read_at (dir->inode, &e, sizeof e, ofs) != sizeof e
+				|| e.state == DIRENT_FREE)
+			break;
+		if (e.state == DIRENT_USED && !strcmp (name, e.name)) {
 			if (ep != NULL)
 				*ep = e;
 			if (ofsp != NULL)
 				*ofsp = ofs;
 			return true;
 		}
+	}
 	return false;
 }
 
+/* Stores the used entries of OLD, OLD_CNT slots, into NEW, NEW_CNT
+ * cleared slots.  Returns false if some entry finds no slot within
+ * DIR_PROBE_MAX of its home. */
+static bool
+rehash (const struct dir_entry *old, size_t old_cnt,
+		struct dir_entry *new, size_t new_cnt) {
+	size_t i, j;
+
+	for (i = 0; i < old_cnt; i++) {
+		if (old[i].state != DIRENT_USED)
+			continue;
+		size_t home = hash_string (old[i].name) % new_cnt;
+		for (j = 0; j < DIR_PROBE_MAX && j < new_cnt; j++)
+			if (new[(home + j) % new_cnt].state == DIRENT_FREE)
+				break;
+		if (j == DIR_PROBE_MAX || j == new_cnt)
+			return false;
+		new[(home + j) % new_cnt] = old[i];
+	}
+	return true;
+}
+
+/* Doubles the slots of DIR, rehashing its entries.  Returns false if
+ * memory or disk space runs out. */
+static bool
+dir_grow (struct dir *dir) {
+	size_t old_cnt = dir_slot_cnt (dir);
+	size_t new_cnt = old_cnt < DIR_MIN_SLOTS ? DIR_MIN_SLOTS : old_cnt * 2;
+	off_t old_size = old_cnt * sizeof (struct dir_entry);
+	struct dir_entry *old = NULL;
+	struct dir_entry *new = NULL;
+	bool success = false;
+
+	if (old_cnt > 0) {
+		old = malloc (old_size);
+		if (old == NULL
+				|| inode_read_at (dir->inode, old, old_size, 0) != old_size)
+			goto done;
+	}
+
+	for (;;) {
+		new = calloc (new_cnt, sizeof *new);
+		if (new == NULL)
+			goto done;
+		if (rehash (old, old_cnt, new, new_cnt))
+			break;
+		free (new);
+		new_cnt *= 2;
+	}
+	off_t new_size = new_cnt * sizeof *new;
+	success = inode_write_at (dir->inode, new, new_size, 0) == new_size;
+
+done:
+	free (new);
+	free (old);
+	return success;
+}
+
 /* Searches DIR for a file with the given NAME
  * and returns true if one exists, false otherwise.
  * On success, sets *INODE to an inode for the file, otherwise to
@@ -109,10 +283,16 @@ dir_lookup (const struct dir *dir, const char *name,
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	if (lookup (dir, name, &e, NULL))
-		*inode = inode_open (e.inode_sector);
-	else
-		*inode = NULL;
+	disk_sector_t dir_sector = inode_get_inumber (dir->inode);
+	disk_sector_t sector;
+
+	inode_lock (dir->inode);
+	if (!dcache_lookup (dir_sector, name, &sector)) {
+		sector = lookup (dir, name, &e, NULL) ? e.inode_sector : 0;
+		dcache_insert (dir_sector, name, sector);
+	}
+	*inode = sector != 0 ? inode_open (sector) : NULL;
+	inode_unlock (dir->inode);
 
 	return *inode != NULL;
 }
@@ -136,29 +316,45 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 	if (*name == '\0' || strlen (name) > NAME_MAX)
 		return false;
 
-	/* Check that NAME is not in use. */
-	if (lookup (dir, name, NULL, NULL))
-		goto done;
-
-	/* Set OFS to offset of free slot.
-	 * If there are no free slots, then it will be set to the
-	 * current end-of-file.
-
-	 * inode_read_at() will only return a short read at end of file.
-	 * Otherwise, we'd need to verify that we didn't get a short
-	 * read due to something intermittent such as low memory. */
-	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-			ofs += sizeof e)
-		if (!e.in_use)
+	/* Look for NAME and for the first reusable slot of its probe run at
+	 * once.  With no slot left in the run, grow the directory. */
+	inode_lock (dir->inode);
+	for (;;) {
+		size_t slots = dir_slot_cnt (dir);
+		size_t home = slots > 0 ? hash_string (name) % slots : 0;
+		off_t target = -1;
+		size_t i;
+
+		for (i = 0; i < DIR_PROBE_MAX && i < slots; i++) {
+			off_t slot_ofs = (home + i) % slots * sizeof e;
+			if (inode_read_at (dir->inode, &e, sizeof e, slot_ofs) != sizeof e)
+				goto done;
+			if (e.state == DIRENT_USED && !strcmp (name, e.name))
+				goto done;
+			if (e.state != DIRENT_USED && target < 0)
+				target = slot_ofs;
+			if (e.state == DIRENT_FREE)
+				break;
+		}
+		if (target >= 0) {
+			ofs = target;
 			break;
+		}
+		if (!dir_grow (dir))
+			goto done;
+	}
 
 	/* Write slot. */
-	e.in_use = true;
+	memset (&e, 0, sizeof e);
+	e.state = DIRENT_USED;
 	strlcpy (e.name, name, sizeof e.name);
 	e.inode_sector = inode_sector;
 	success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+	if (success)
+		dcache_insert (inode_get_inumber (dir->inode), name, inode_sector);
 
 done:
+	inode_unlock (dir->inode);
 	return success;
 }
 
@@ -176,6 +372,7 @@ dir_remove (struct dir *dir, const char *name) {
 	ASSERT (name != NULL);
 
 	/* Find directory entry. */
+	inode_lock (dir->inode);
 	if (!lookup (dir, name, &e, &ofs))
 		goto done;
 
@@ -185,15 +382,17 @@ dir_remove (struct dir *dir, const char *name) {
 		goto done;
 
 	/* Erase directory entry. */
-	e.in_use = false;
+	e.state = DIRENT_DELETED;
 	if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
 		goto done;
+	dcache_insert (inode_get_inumber (dir->inode), name, 0);
 
 	/* Remove inode. */
 	inode_remove (inode);
 	success = true;
 
 done:
+	inode_unlock (dir->inode);
 	inode_close (inode);
 	return success;
 }
@@ -204,13 +403,17 @@ done:
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1]) {
 	struct dir_entry e;
+	bool found = false;
 
+	inode_lock (dir->inode);
 	while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) {
 		dir->pos += sizeof e;
-		if (e.in_use) {
+		if (e.state == DIRENT_USED) {
 			strlcpy (name, e.name, NAME_MAX + 1);
-			return true;
+			found = true;
+			break;
 		}
 	}
-	return false;
+	inode_unlock (dir->inode);
+	return found;
 }
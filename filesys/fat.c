@@ -3,6 +3,8 @@
 #include "filesys/filesys.h"
 #include "threads/malloc.h"
 #include "threads/synch.h"
+#include <bitmap.h>
+#include <debug.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -22,10 +24,14 @@ struct fat_fs {
 	unsigned int *fat;
 	unsigned int fat_length;
 	disk_sector_t data_start;
-	cluster_t last_clst;
+	cluster_t last_clst;          /* Where the next free-cluster search starts. */
 	struct lock write_lock;
+	struct bitmap *dirty;         /* FAT sectors changed since the last flush. */
 };
 
+/* FAT entries per sector of the table. */
+#define FAT_PER_SECTOR (DISK_SECTOR_SIZE / sizeof (cluster_t))
+
 static struct fat_fs *fat_fs;
 
 void fat_boot_create (void);
@@ -53,6 +59,7 @@ fat_init (void) {
 
 void
 fat_open (void) {
+	free (fat_fs->fat);
 	fat_fs->fat = calloc (fat_fs->fat_length, sizeof (cluster_t));
 	if (fat_fs->fat == NULL)
 		PANIC ("FAT load failed");
@@ -90,27 +97,46 @@ fat_close (void) {
 	disk_write (filesys_disk, FAT_BOOT_SECTOR, bounce);
 	free (bounce);
 
-	// Write FAT directly to the disk
-	uint8_t *buffer = (uint8_t *) fat_fs->fat;
-	off_t bytes_wrote = 0;
-	off_t bytes_left = sizeof (fat_fs->fat);
+	// Write the changed part of the FAT
+	fat_flush ();
+}
+
+/* Writes the FAT sectors changed since the last flush to the disk.
+ * fat_put only marks them, so a burst of allocations in one sector of
+ * the table costs one write.  Each sector is copied out under the write
+ * lock and written after releasing it; a change made meanwhile marks
+ * the sector again for the next flush. */
+void
+fat_flush (void) {
+	if (fat_fs == NULL || fat_fs->fat == NULL)
+		return;
+
+	uint8_t *bounce = malloc (DISK_SECTOR_SIZE);
+	if (bounce == NULL)
+		PANIC ("FAT flush failed");
+	const uint8_t *buffer = (const uint8_t *) fat_fs->fat;
 	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
-		bytes_left = fat_size_in_bytes - bytes_wrote;
-		if (bytes_left >= DISK_SECTOR_SIZE) {
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i,
-			            buffer + bytes_wrote);
-			bytes_wrote += DISK_SECTOR_SIZE;
-		} else {
-			bounce = calloc (1, DISK_SECTOR_SIZE);
-			if (bounce == NULL)
-				PANIC ("FAT close failed");
-			memcpy (bounce, buffer + bytes_wrote, bytes_left);
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i, bounce);
-			bytes_wrote += bytes_left;
-			free (bounce);
+	size_t i = 0;
+	for (;;) {
+		lock_acquire (&fat_fs->write_lock);
+		i = bitmap_scan_and_flip (fat_fs->dirty, i, 1, true);
+		if (i == BITMAP_ERROR) {
+			lock_release (&fat_fs->write_lock);
+			break;
+		}
+		off_t ofs = i * DISK_SECTOR_SIZE;
+		off_t bytes_left = fat_size_in_bytes - ofs;
+		if (bytes_left >= DISK_SECTOR_SIZE)
+			memcpy (bounce, buffer + ofs, DISK_SECTOR_SIZE);
+		else {
+			memset (bounce, 0, DISK_SECTOR_SIZE);
+			memcpy (bounce, buffer + ofs, bytes_left);
 		}
+		lock_release (&fat_fs->write_lock);
+
+		disk_write (filesys_disk, fat_fs->bs.fat_start + i, bounce);
 	}
+	free (bounce);
 }
 
 void
@@ -124,6 +150,9 @@ fat_create (void) {
 	if (fat_fs->fat == NULL)
 		PANIC ("FAT creation failed");
 
+	// The new table goes to the disk as a whole
+	bitmap_set_all (fat_fs->dirty, true);
+
 	// Set up ROOT_DIR_CLST
 	fat_put (ROOT_DIR_CLUSTER, EOChain);
 
@@ -152,7 +181,21 @@ fat_boot_create (void) {
 
 void
 fat_fs_init (void) {
-	/* TODO: Your code goes here. */
+	/* Cluster 0 marks a free entry, data clusters are numbered from 1
+	 * (the root directory) and the table holds one entry per cluster. */
+	fat_fs->data_start = fat_fs->bs.fat_start + fat_fs->bs.fat_sectors;
+	fat_fs->fat_length = (fat_fs->bs.total_sectors - fat_fs->data_start)
+		/ SECTORS_PER_CLUSTER + 1;
+	if (fat_fs->fat_length > fat_fs->bs.fat_sectors * FAT_PER_SECTOR)
+		fat_fs->fat_length = fat_fs->bs.fat_sectors * FAT_PER_SECTOR;
+	fat_fs->last_clst = ROOT_DIR_CLUSTER + 1;
+	lock_init (&fat_fs->write_lock);
+
+	if (fat_fs->dirty != NULL)
+		bitmap_destroy (fat_fs->dirty);
+	fat_fs->dirty = bitmap_create (fat_fs->bs.fat_sectors);
+	if (fat_fs->dirty == NULL)
+		PANIC ("FAT init failed");
 }
 
 /*----------------------------------------------------------------------------*/
@@ -164,30 +207,74 @@ fat_fs_init (void) {
  * Returns 0 if fails to allocate a new cluster. */
 cluster_t
 fat_create_chain (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	cluster_t new = 0;
+
+	if (fat_fs->fat_length <= ROOT_DIR_CLUSTER + 1)
+		return 0;
+	lock_acquire (&fat_fs->write_lock);
+	/* Next-fit: start after the last cluster handed out and wrap once,
+	 * instead of scanning the table from the front every time. */
+	for (cluster_t i = 0; i < fat_fs->fat_length - 2; i++) {
+		cluster_t c = fat_fs->last_clst + i;
+		if (c >= fat_fs->fat_length)
+			c -= fat_fs->fat_length - 2;
+		if (fat_fs->fat[c] == 0) {
+			new = c;
+			break;
+		}
+	}
+	if (new != 0) {
+		fat_put (new, EOChain);
+		if (clst != 0)
+			fat_put (clst, new);
+		fat_fs->last_clst = new + 1 < fat_fs->fat_length ? new + 1 : ROOT_DIR_CLUSTER + 1;
+	}
+	lock_release (&fat_fs->write_lock);
+	return new;
 }
 
 /* Remove the chain of clusters starting from CLST.
  * If PCLST is 0, assume CLST as the start of the chain. */
 void
 fat_remove_chain (cluster_t clst, cluster_t pclst) {
-	/* TODO: Your code goes here. */
+	lock_acquire (&fat_fs->write_lock);
+	if (pclst != 0)
+		fat_put (pclst, EOChain);
+	while (clst != 0 && clst != EOChain) {
+		cluster_t next = fat_fs->fat[clst];
+		fat_put (clst, 0);
+		clst = next;
+	}
+	lock_release (&fat_fs->write_lock);
 }
 
 /* Update a value in the FAT table. */
 void
 fat_put (cluster_t clst, cluster_t val) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst > 0 && clst < fat_fs->fat_length);
+	if (fat_fs->fat[clst] != val) {
+		fat_fs->fat[clst] = val;
+		bitmap_mark (fat_fs->dirty, clst / FAT_PER_SECTOR);
+	}
 }
 
 /* Fetch a value in the FAT table. */
 cluster_t
 fat_get (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst > 0 && clst < fat_fs->fat_length);
+	return fat_fs->fat[clst];
 }
 
 /* Covert a cluster # to a sector number. */
 disk_sector_t
 cluster_to_sector (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst > 0);
+	return fat_fs->data_start + (clst - 1) * SECTORS_PER_CLUSTER;
+}
+
+/* Covert a sector number to the cluster # that contains it. */
+cluster_t
+sector_to_cluster (disk_sector_t sector) {
+	ASSERT (sector >= fat_fs->data_start);
+	return (sector - fat_fs->data_start) / SECTORS_PER_CLUSTER + 1;
 }
@@ -2,12 +2,15 @@
 #include <debug.h>
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* An open file. */
 struct file {
 	struct inode *inode;        /* File's inode. */
 	off_t pos;                  /* Current position. */
 	bool deny_write;            /* Has file_deny_write() been called? */
+	struct lock pos_lock;       /* Makes each use of POS atomic. */
+	struct inode_cursor cursor; /* Index block near POS, under POS_LOCK. */
 };
 
 /* Opens a file for the given INODE, of which it takes ownership,
@@ -20,6 +23,7 @@ file_open (struct inode *inode) {
 		file->inode = inode;
 		file->pos = 0;
 		file->deny_write = false;
+		lock_init (&file->pos_lock);
 		return file;
 	} else {
 		inode_close (inode);
@@ -41,7 +45,7 @@ struct file *
 file_duplicate (struct file *file) {
 	struct file *nfile = file_open (inode_reopen (file->inode));
 	if (nfile) {
-		nfile->pos = file->pos;
+		nfile->pos = file_tell (file);
 		if (file->deny_write)
 			file_deny_write (nfile);
 	}
@@ -68,11 +72,16 @@ file_get_inode (struct file *file) {
  * starting at the file's current position.
  * Returns the number of bytes actually read,
  * which may be less than SIZE if end of file is reached.
- * Advances FILE's position by the number of bytes read. */
+ * Advances FILE's position by the number of bytes read.
+ * FILE may be shared, so the read and the advance are done under
+ * FILE's position lock. */
 off_t
 file_read (struct file *file, void *buffer, off_t size) {
-	off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+	lock_acquire (&file->pos_lock);
+	off_t bytes_read = inode_read_cursor (file->inode, &file->cursor, buffer,
+			size, file->pos);
 	file->pos += bytes_read;
+	lock_release (&file->pos_lock);
 	return bytes_read;
 }
 
@@ -92,11 +101,15 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) {
  * which may be less than SIZE if end of file is reached.
  * (Normally we'd grow the file in that case, but file growth is
  * not yet implemented.)
- * Advances FILE's position by the number of bytes read. */
+ * Advances FILE's position by the number of bytes read,
+ * under FILE's position lock as in file_read(). */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) {
-	off_t bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
+	lock_acquire (&file->pos_lock);
+	off_t bytes_written = inode_write_cursor (file->inode, &file->cursor,
+			buffer, size, file->pos);
 	file->pos += bytes_written;
+	lock_release (&file->pos_lock);
 	return bytes_written;
 }
 
@@ -149,7 +162,9 @@ void
 file_seek (struct file *file, off_t new_pos) {
 	ASSERT (file != NULL);
 	ASSERT (new_pos >= 0);
+	lock_acquire (&file->pos_lock);
 	file->pos = new_pos;
+	lock_release (&file->pos_lock);
 }
 
 /* Returns the current position in FILE as a byte offset from the
@@ -157,5 +172,8 @@ file_seek (struct file *file, off_t new_pos) {
 off_t
 file_tell (struct file *file) {
 	ASSERT (file != NULL);
-	return file->pos;
+	lock_acquire (&file->pos_lock);
+	off_t pos = file->pos;
+	lock_release (&file->pos_lock);
+	return pos;
 }
@@ -1,12 +1,50 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#ifdef EFILESYS
+#include "filesys/fat.h"
+#endif
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per disk sector. */
+static struct lock free_map_lock;    /* Guards everything here. */
+
+/* Summary of the free map: the number of free sectors in each group of
+ * FREE_MAP_GROUP sectors, so the allocator steps over full groups
+ * without testing their bits.  Allocation is next-fit, resuming at
+ * FREE_MAP_NEXT.  Changes are not written to the free map file at once;
+ * FREE_MAP_DIRTY records that the file is stale until free_map_flush,
+ * which free_map_flushd calls every FREE_MAP_FLUSH_TICKS. */
+#define FREE_MAP_GROUP 1024
+#define FREE_MAP_FLUSH_TICKS TIMER_FREQ
+
+static size_t *group_free;           /* Free sectors per group. */
+static size_t group_cnt;
+static disk_sector_t free_map_next;  /* Where the next search starts. */
+static bool free_map_dirty;
+static bool free_map_flushd_started;
+
+/* Recounts every group of the summary from the free map. */
+static void
+summary_rebuild (void) {
+	size_t g;
+
+	for (g = 0; g < group_cnt; g++) {
+		size_t start = g * FREE_MAP_GROUP;
+		size_t end = start + FREE_MAP_GROUP;
+		if (end > bitmap_size (free_map))
+			end = bitmap_size (free_map);
+		group_free[g] = bitmap_count (free_map, start, end - start, false);
+	}
+}
 
 /* Initializes the free map. */
 void
@@ -14,8 +52,76 @@ free_map_init (void) {
 	free_map = bitmap_create (disk_size (filesys_disk));
 	if (free_map == NULL)
 		PANIC ("bitmap creation failed--disk is too large");
+	group_cnt = DIV_ROUND_UP (bitmap_size (free_map), FREE_MAP_GROUP);
+	group_free = calloc (group_cnt, sizeof *group_free);
+	if (group_free == NULL)
+		PANIC ("free map summary creation failed");
+	lock_init (&free_map_lock);
 	bitmap_mark (free_map, FREE_MAP_SECTOR);
 	bitmap_mark (free_map, ROOT_DIR_SECTOR);
+	summary_rebuild ();
+	free_map_next = 0;
+	free_map_dirty = false;
+}
+
+#ifdef EFILESYS
+/* With FAT, the FAT is the free map: each sector is one cluster, kept
+ * as a chain of its own.  Only single sectors are asked for.  The FAT's
+ * own lock serializes allocation. */
+bool
+free_map_allocate (size_t cnt, disk_sector_t *sectorp) {
+	ASSERT (cnt == 1);
+	cluster_t clst = fat_create_chain (0);
+	if (clst == 0)
+		return false;
+	*sectorp = cluster_to_sector (clst);
+	return true;
+}
+
+/* Makes CNT sectors starting at SECTOR available for use. */
+void
+free_map_release (disk_sector_t sector, size_t cnt) {
+	size_t i;
+
+	for (i = 0; i < cnt; i++)
+		fat_remove_chain (sector_to_cluster (sector + i), 0);
+}
+#else
+/* Sets the CNT sectors starting at SECTOR to USED in the free map and
+ * the summary. */
+static void
+summary_mark (disk_sector_t sector, size_t cnt, bool used) {
+	size_t i;
+
+	bitmap_set_multiple (free_map, sector, cnt, used);
+	for (i = sector; i < sector + cnt; i++) {
+		if (used)
+			group_free[i / FREE_MAP_GROUP]--;
+		else
+			group_free[i / FREE_MAP_GROUP]++;
+	}
+	free_map_dirty = true;
+}
+
+/* Returns the first sector in [START, END) that begins a run of CNT
+ * free sectors, or BITMAP_ERROR.  Groups with no free sector are
+ * skipped whole. */
+static size_t
+extent_scan (size_t start, size_t end, size_t cnt) {
+	size_t i = start;
+
+	while (i + cnt <= end) {
+		size_t g = i / FREE_MAP_GROUP;
+		if (group_free[g] == 0) {
+			i = (g + 1) * FREE_MAP_GROUP;
+			continue;
+		}
+		if (!bitmap_test (free_map, i)
+				&& (cnt == 1 || bitmap_none (free_map, i, cnt)))
+			return i;
+		i++;
+	}
+	return BITMAP_ERROR;
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -24,13 +130,18 @@ free_map_init (void) {
  * available. */
 bool
 free_map_allocate (size_t cnt, disk_sector_t *sectorp) {
-	disk_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-	if (sector != BITMAP_ERROR
-			&& free_map_file != NULL
-			&& !bitmap_write (free_map, free_map_file)) {
-		bitmap_set_multiple (free_map, sector, cnt, false);
-		sector = BITMAP_ERROR;
+	size_t size = bitmap_size (free_map);
+
+	lock_acquire (&free_map_lock);
+	size_t sector = extent_scan (free_map_next, size, cnt);
+	if (sector == BITMAP_ERROR)
+		sector = extent_scan (0, free_map_next + cnt - 1 < size
+				? free_map_next + cnt - 1 : size, cnt);
+	if (sector != BITMAP_ERROR) {
+		summary_mark (sector, cnt, true);
+		free_map_next = (sector + cnt) % size;
 	}
+	lock_release (&free_map_lock);
 	if (sector != BITMAP_ERROR)
 		*sectorp = sector;
 	return sector != BITMAP_ERROR;
@@ -39,12 +150,40 @@ free_map_allocate (size_t cnt, disk_sector_t *sectorp) {
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (disk_sector_t sector, size_t cnt) {
+	lock_acquire (&free_map_lock);
 	ASSERT (bitmap_all (free_map, sector, cnt));
-	bitmap_set_multiple (free_map, sector, cnt, false);
-	bitmap_write (free_map, free_map_file);
+	summary_mark (sector, cnt, false);
+	lock_release (&free_map_lock);
 }
+#endif
 
-/* Opens the free map file and reads it from disk. */
+/* Writes the free map to its file if it changed since the last
+ * write.  Many allocations and releases thus cost one write. */
+void
+free_map_flush (void) {
+	if (free_map == NULL)
+		return;
+	lock_acquire (&free_map_lock);
+	if (free_map_dirty && free_map_file != NULL) {
+		if (!bitmap_write (free_map, free_map_file))
+			PANIC ("can't write free map");
+		free_map_dirty = false;
+	}
+	lock_release (&free_map_lock);
+}
+
+/* Writes the free map back periodically, so that the file lags
+ * behind by at most FREE_MAP_FLUSH_TICKS. */
+static void
+free_map_flushd (void *aux UNUSED) {
+	for (;;) {
+		timer_sleep (FREE_MAP_FLUSH_TICKS);
+		free_map_flush ();
+	}
+}
+
+/* Opens the free map file and reads it from disk, then starts
+ * free_map_flushd if it is not running yet. */
 void
 free_map_open (void) {
 	free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
@@ -52,12 +191,24 @@ free_map_open (void) {
 		PANIC ("can't open free map");
 	if (!bitmap_read (free_map, free_map_file))
 		PANIC ("can't read free map");
+	summary_rebuild ();
+	free_map_dirty = false;
+
+	if (!free_map_flushd_started) {
+		free_map_flushd_started = true;
+		thread_create ("freemapd", PRI_DEFAULT, free_map_flushd, NULL);
+	}
 }
 
-/* Writes the free map to disk and closes the free map file. */
+/* Writes the free map to disk and closes the free map file.  The file
+ * goes away under FREE_MAP_LOCK, which free_map_flushd takes too. */
 void
 free_map_close (void) {
+	free_map_flush ();
+	lock_acquire (&free_map_lock);
 	file_close (free_map_file);
+	free_map_file = NULL;
+	lock_release (&free_map_lock);
 }
 
 /* Creates a new free map file on disk and writes the free map to
@@ -74,4 +225,5 @@ free_map_create (void) {
 		PANIC ("can't open free map");
 	if (!bitmap_write (free_map, free_map_file))
 		PANIC ("can't write free map");
+	free_map_dirty = false;
 }
@@ -1,22 +1,39 @@
 #include "filesys/inode.h"
 #include <list.h>
+#include <hash.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#ifdef EFILESYS
+#include "filesys/page_cache.h"
+#endif
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Sector numbers held by the on-disk index.  A slot that is 0 has no
+ * sector yet; sector 0 never holds file data. */
+#define DIRECT_CNT 123
+#define INDIRECT_CNT (DISK_SECTOR_SIZE / sizeof (disk_sector_t))
+#define NO_SECTOR 0
+
 /* On-disk inode.
- * Must be exactly DISK_SECTOR_SIZE bytes long. */
+ * Must be exactly DISK_SECTOR_SIZE bytes long.
+ * Data sectors are reached through DIRECT_CNT direct slots, then one
+ * indirect block of INDIRECT_CNT slots, then one doubly indirect block,
+ * so any sector is at most two index reads away. */
 struct inode_disk {
-	disk_sector_t start;                /* First data sector. */
 	off_t length;                       /* File size in bytes. */
 	unsigned magic;                     /* Magic number. */
-	uint32_t unused[125];               /* Not used. */
+	disk_sector_t direct[DIRECT_CNT];   /* First data sectors. */
+	disk_sector_t indirect;             /* Block of the next INDIRECT_CNT. */
+	disk_sector_t doubly_indirect;      /* Block of indirect blocks. */
+	uint32_t unused[1];                 /* Not used. */
 };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -28,35 +45,245 @@ bytes_to_sectors (off_t size) {
 
 /* In-memory inode. */
 struct inode {
-	struct list_elem elem;              /* Element in inode list. */
+	struct hash_elem elem;              /* Element in open_inodes. */
 	disk_sector_t sector;               /* Sector number of disk location. */
 	int open_cnt;                       /* Number of openers. */
 	bool removed;                       /* True if deleted, false otherwise. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
 	struct inode_disk data;             /* Inode content. */
+	struct rwlock rw;                   /* Guards DATA and DENY_WRITE_CNT. */
+	struct lock lock;                   /* See inode_lock(). */
 };
 
+/* Reads or writes a whole SECTOR of filesys_disk, through the buffer
+ * cache when there is one. */
+static void
+sector_read (disk_sector_t sector, void *buffer) {
+#ifdef EFILESYS
+	page_cache_read (sector, buffer, 0, DISK_SECTOR_SIZE);
+#else
+	disk_read (filesys_disk, sector, buffer);
+#endif
+}
+
+static void
+sector_write (disk_sector_t sector, const void *buffer) {
+#ifdef EFILESYS
+	page_cache_write (sector, buffer, 0, DISK_SECTOR_SIZE);
+#else
+	disk_write (filesys_disk, sector, buffer);
+#endif
+}
+
+/* Allocates a zeroed sector into *SLOT unless it already has one.
+ * Returns false if the disk is full. */
+static bool
+sector_ensure (disk_sector_t *slot) {
+	static char zeros[DISK_SECTOR_SIZE];
+
+	if (*slot != NO_SECTOR)
+		return true;
+	if (!free_map_allocate (1, slot))
+		return false;
+	sector_write (*slot, zeros);
+	return true;
+}
+
+/* Looks up entry IDX of the index block in *BLOCK.  With CREATE, missing
+ * blocks and entries are allocated and zeroed.  Returns NO_SECTOR if the
+ * entry has no sector. */
+static disk_sector_t
+index_lookup (disk_sector_t *block, size_t idx, bool create) {
+	disk_sector_t entries[INDIRECT_CNT];
+
+	if (*block == NO_SECTOR && (!create || !sector_ensure (block)))
+		return NO_SECTOR;
+	sector_read (*block, entries);
+	if (entries[idx] == NO_SECTOR && create) {
+		if (!sector_ensure (&entries[idx]))
+			return NO_SECTOR;
+		sector_write (*block, entries);
+	}
+	return entries[idx];
+}
+
+/* Returns the sector holding sector number IDX of the file described by
+ * DATA, or NO_SECTOR if it has none.  With CREATE, the sector and the
+ * index blocks leading to it are allocated as needed. */
+static disk_sector_t
+index_to_sector (struct inode_disk *data, size_t idx, bool create) {
+	if (idx < DIRECT_CNT) {
+		if (create && !sector_ensure (&data->direct[idx]))
+			return NO_SECTOR;
+		return data->direct[idx];
+	}
+	idx -= DIRECT_CNT;
+
+	if (idx < INDIRECT_CNT)
+		return index_lookup (&data->indirect, idx, create);
+	idx -= INDIRECT_CNT;
+
+	if (idx < INDIRECT_CNT * INDIRECT_CNT) {
+		disk_sector_t indirect = index_lookup (&data->doubly_indirect,
+				idx / INDIRECT_CNT, create);
+		if (indirect == NO_SECTOR)
+			return NO_SECTOR;
+		return index_lookup (&indirect, idx % INDIRECT_CNT, create);
+	}
+	return NO_SECTOR;
+}
+
+/* Gives DATA sectors for its first LENGTH bytes, leaving its length
+ * alone.  Returns false if the disk is full; the sectors allocated so
+ * far stay in the index and are reused by the next attempt. */
+static bool
+inode_allocate (struct inode_disk *data, off_t length) {
+	size_t i;
+
+	for (i = bytes_to_sectors (data->length); i < bytes_to_sectors (length); i++)
+		if (index_to_sector (data, i, true) == NO_SECTOR)
+			return false;
+	return true;
+}
+
+/* Gives DATA sectors for its first LENGTH bytes and sets its length. */
+static bool
+inode_extend (struct inode_disk *data, off_t length) {
+	if (!inode_allocate (data, length))
+		return false;
+	if (length > data->length)
+		data->length = length;
+	return true;
+}
+
+/* Releases every sector of index block BLOCK, which is LEVEL levels above
+ * the data, and the block itself. */
+static void
+index_release (disk_sector_t block, int level) {
+	size_t i;
+
+	if (block == NO_SECTOR)
+		return;
+	if (level > 0) {
+		/* Not on the stack, this recurses. */
+		disk_sector_t *entries = malloc (DISK_SECTOR_SIZE);
+		if (entries != NULL) {
+			sector_read (block, entries);
+			for (i = 0; i < INDIRECT_CNT; i++)
+				index_release (entries[i], level - 1);
+			free (entries);
+		}
+	}
+	free_map_release (block, 1);
+}
+
+/* Releases all data and index sectors of DATA. */
+static void
+inode_release (struct inode_disk *data) {
+	size_t i;
+
+	for (i = 0; i < DIRECT_CNT; i++)
+		index_release (data->direct[i], 0);
+	index_release (data->indirect, 1);
+	index_release (data->doubly_indirect, 2);
+}
+
+/* Returns the index block holding the slot of sector number IDX, which
+ * lies past the direct slots, and sets *FIRST to the sector number of
+ * the block's slot 0.  Returns NO_SECTOR if there is no such block. */
+static disk_sector_t
+index_block (const struct inode_disk *data, size_t idx, size_t *first) {
+	disk_sector_t doubly = data->doubly_indirect;
+
+	ASSERT (idx >= DIRECT_CNT);
+	idx -= DIRECT_CNT;
+	if (idx < INDIRECT_CNT) {
+		*first = DIRECT_CNT;
+		return data->indirect;
+	}
+	idx -= INDIRECT_CNT;
+
+	if (idx >= INDIRECT_CNT * INDIRECT_CNT)
+		return NO_SECTOR;
+	*first = DIRECT_CNT + INDIRECT_CNT + idx / INDIRECT_CNT * INDIRECT_CNT;
+	return index_lookup (&doubly, idx / INDIRECT_CNT, false);
+}
+
+/* Returns the sector holding sector number IDX of DATA, or NO_SECTOR,
+ * like index_to_sector() without CREATE.  Past the direct slots, the
+ * index block is read into CURSOR, if not null, unless CURSOR already
+ * holds it.  Slots only ever go from NO_SECTOR to a sector while the
+ * file is open, so only an empty slot in CURSOR needs a fresh read. */
+static disk_sector_t
+cursor_to_sector (const struct inode_disk *data, struct inode_cursor *cursor,
+		size_t idx) {
+	size_t first;
+	disk_sector_t block;
+
+	if (cursor == NULL || idx < DIRECT_CNT)
+		return index_to_sector ((struct inode_disk *) data, idx, false);
+	if (cursor->first == 0 || idx < cursor->first
+			|| idx >= cursor->first + INDIRECT_CNT
+			|| cursor->slots[idx - cursor->first] == NO_SECTOR) {
+		block = index_block (data, idx, &first);
+		if (block == NO_SECTOR)
+			return NO_SECTOR;
+		sector_read (block, cursor->slots);
+		cursor->first = first;
+	}
+	return cursor->slots[idx - cursor->first];
+}
+
 /* Returns the disk sector that contains byte offset POS within
- * INODE.
+ * INODE, looked up through CURSOR, which may be null.
  * Returns -1 if INODE does not contain data for a byte at offset
  * POS. */
 static disk_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) {
+byte_to_sector (const struct inode *inode, struct inode_cursor *cursor,
+		off_t pos) {
 	ASSERT (inode != NULL);
 	if (pos < inode->data.length)
-		return inode->data.start + pos / DISK_SECTOR_SIZE;
+		return cursor_to_sector (&inode->data, cursor, pos / DISK_SECTOR_SIZE);
 	else
 		return -1;
 }
 
-/* List of open inodes, so that opening a single inode twice
- * returns the same `struct inode'. */
-static struct list open_inodes;
+/* Open inodes keyed by sector, so that opening a single inode twice
+ * returns the same `struct inode'.  OPEN_INODES_LOCK protects the table
+ * and the open counts; it is never held across disk I/O. */
+static struct hash open_inodes;
+static struct lock open_inodes_lock;
+
+static uint64_t
+inode_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct inode *inode = hash_entry (e, struct inode, elem);
+	return hash_int (inode->sector);
+}
+
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct inode, elem)->sector
+		< hash_entry (b, struct inode, elem)->sector;
+}
+
+/* Returns the open inode for SECTOR, or a null pointer.  The caller must
+ * hold OPEN_INODES_LOCK. */
+static struct inode *
+open_inodes_find (disk_sector_t sector) {
+	struct inode key;
+	struct hash_elem *e;
+
+	key.sector = sector;
+	e = hash_find (&open_inodes, &key.elem);
+	return e != NULL ? hash_entry (e, struct inode, elem) : NULL;
+}
 
 /* Initializes the inode module. */
 void
 inode_init (void) {
-	list_init (&open_inodes);
+	hash_init (&open_inodes, inode_hash, inode_less, NULL);
+	lock_init (&open_inodes_lock);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -77,20 +304,13 @@ inode_create (disk_sector_t sector, off_t length) {
 
 	disk_inode = calloc (1, sizeof *disk_inode);
 	if (disk_inode != NULL) {
-		size_t sectors = bytes_to_sectors (length);
-		disk_inode->length = length;
 		disk_inode->magic = INODE_MAGIC;
-		if (free_map_allocate (sectors, &disk_inode->start)) {
-			disk_write (filesys_disk, sector, disk_inode);
-			if (sectors > 0) {
-				static char zeros[DISK_SECTOR_SIZE];
-				size_t i;
-
-				for (i = 0; i < sectors; i++) 
-					disk_write (filesys_disk, disk_inode->start + i, zeros); 
-			}
+		if (inode_extend (disk_inode, length)) {
+			sector_write (sector, disk_inode);
 			success = true; 
 		} 
+		else
+			inode_release (disk_inode);
 		free (disk_inode);
 	}
 	return success;
@@ -101,39 +321,54 @@ inode_create (disk_sector_t sector, off_t length) {
  * Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (disk_sector_t sector) {
-	struct list_elem *e;
 	struct inode *inode;
 
 	/* Check whether this inode is already open. */
-	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-			e = list_next (e)) {
-		inode = list_entry (e, struct inode, elem);
-		if (inode->sector == sector) {
-			inode_reopen (inode);
-			return inode; 
-		}
+	lock_acquire (&open_inodes_lock);
+	inode = open_inodes_find (sector);
+	if (inode != NULL) {
+		inode->open_cnt++;
+		lock_release (&open_inodes_lock);
+		return inode; 
 	}
+	lock_release (&open_inodes_lock);
 
 	/* Allocate memory. */
 	inode = malloc (sizeof *inode);
 	if (inode == NULL)
 		return NULL;
 
-	/* Initialize. */
-	list_push_front (&open_inodes, &inode->elem);
+	/* Initialize.  The disk read happens without the lock, so the table
+	 * is checked again: another thread may have opened SECTOR meanwhile. */
 	inode->sector = sector;
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
-	disk_read (filesys_disk, inode->sector, &inode->data);
+	rwlock_init (&inode->rw);
+	lock_init (&inode->lock);
+	sector_read (inode->sector, &inode->data);
+
+	lock_acquire (&open_inodes_lock);
+	struct inode *other = open_inodes_find (sector);
+	if (other != NULL) {
+		other->open_cnt++;
+		lock_release (&open_inodes_lock);
+		free (inode);
+		return other;
+	}
+	hash_insert (&open_inodes, &inode->elem);
+	lock_release (&open_inodes_lock);
 	return inode;
 }
 
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode) {
-	if (inode != NULL)
+	if (inode != NULL) {
+		lock_acquire (&open_inodes_lock);
 		inode->open_cnt++;
+		lock_release (&open_inodes_lock);
+	}
 	return inode;
 }
 
@@ -153,15 +388,17 @@ inode_close (struct inode *inode) {
 		return;
 
 	/* Release resources if this was the last opener. */
-	if (--inode->open_cnt == 0) {
-		/* Remove from inode list and release lock. */
-		list_remove (&inode->elem);
+	lock_acquire (&open_inodes_lock);
+	bool last = --inode->open_cnt == 0;
+	if (last)
+		hash_delete (&open_inodes, &inode->elem);
+	lock_release (&open_inodes_lock);
 
+	if (last) {
 		/* Deallocate blocks if removed. */
 		if (inode->removed) {
 			free_map_release (inode->sector, 1);
-			free_map_release (inode->data.start,
-					bytes_to_sectors (inode->data.length)); 
+			inode_release (&inode->data);
 		}
 
 		free (inode); 
@@ -173,25 +410,51 @@ inode_close (struct inode *inode) {
 void
 inode_remove (struct inode *inode) {
 	ASSERT (inode != NULL);
+	lock_acquire (&open_inodes_lock);
 	inode->removed = true;
+	lock_release (&open_inodes_lock);
+}
+
+/* Serializes updates of INODE's contents that take more than one
+ * inode_read_at() or inode_write_at(), such as directory operations.
+ * The lock guards nothing inside this module. */
+void
+inode_lock (struct inode *inode) {
+	lock_acquire (&inode->lock);
+}
+
+void
+inode_unlock (struct inode *inode) {
+	lock_release (&inode->lock);
 }
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
  * Returns the number of bytes actually read, which may be less
- * than SIZE if an error occurs or end of file is reached. */
+ * than SIZE if an error occurs or end of file is reached.
+ * INODE's lock is held only while a sector is looked up, never while
+ * BUFFER is touched, since BUFFER may be user memory that faults. */
 off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
+	return inode_read_cursor (inode, NULL, buffer_, size, offset);
+}
+
+/* Like inode_read_at(), looking sectors up through CURSOR. */
+off_t
+inode_read_cursor (struct inode *inode, struct inode_cursor *cursor,
+		void *buffer_, off_t size, off_t offset) {
 	uint8_t *buffer = buffer_;
 	off_t bytes_read = 0;
 	uint8_t *bounce = NULL;
 
 	while (size > 0) {
 		/* Disk sector to read, starting byte offset within sector. */
-		disk_sector_t sector_idx = byte_to_sector (inode, offset);
+		rwlock_acquire_read (&inode->rw);
+		disk_sector_t sector_idx = byte_to_sector (inode, cursor, offset);
 		int sector_ofs = offset % DISK_SECTOR_SIZE;
 
 		/* Bytes left in inode, bytes left in sector, lesser of the two. */
 		off_t inode_left = inode_length (inode) - offset;
+		rwlock_release_read (&inode->rw);
 		int sector_left = DISK_SECTOR_SIZE - sector_ofs;
 		int min_left = inode_left < sector_left ? inode_left : sector_left;
 
@@ -200,6 +463,21 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 		if (chunk_size <= 0)
 			break;
 
+#ifdef EFILESYS
+		/* The cache copies under its lock, so user memory, which may
+		 * fault back into the file system, goes through a bounce buffer
+		 * filled first and copied out after. */
+		if (is_user_vaddr (buffer)) {
+			if (bounce == NULL) {
+				bounce = malloc (DISK_SECTOR_SIZE);
+				if (bounce == NULL)
+					break;
+			}
+			page_cache_read (sector_idx, bounce, sector_ofs, chunk_size);
+			memcpy (buffer + bytes_read, bounce, chunk_size);
+		} else
+			page_cache_read (sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
+#else
 		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
 			/* Read full sector directly into caller's buffer. */
 			disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
@@ -214,6 +492,7 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 			disk_read (filesys_disk, sector_idx, bounce);
 			memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
 		}
+#endif
 
 		/* Advance. */
 		size -= chunk_size;
@@ -222,39 +501,97 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 	}
 	free (bounce);
 
+#ifdef EFILESYS
+	/* Start on the sector after the last one read. */
+	off_t next = ROUND_UP (offset, DISK_SECTOR_SIZE);
+	disk_sector_t next_sector = NO_SECTOR;
+	rwlock_acquire_read (&inode->rw);
+	if (bytes_read > 0 && next < inode_length (inode))
+		next_sector = byte_to_sector (inode, cursor, next);
+	rwlock_release_read (&inode->rw);
+	if (next_sector != NO_SECTOR)
+		page_cache_prefetch (next_sector);
+#endif
+
 	return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
  * Returns the number of bytes actually written, which may be
- * less than SIZE if end of file is reached or an error occurs.
- * (Normally a write at end of file would extend the inode, but
- * growth is not yet implemented.) */
+ * less than SIZE if the disk fills up or an error occurs.
+ * A write past end of file allocates the sectors first, holding INODE's
+ * lock exclusively, but sets the new length only once the data is in
+ * them, so a concurrent reader at the old end of file sees either
+ * nothing or the new bytes, never the zeroed sectors.  Otherwise, as in
+ * inode_read_at(), the lock is held only while a sector is looked up.
+ * Concurrent writes to the same sector are not atomic with respect to
+ * each other. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		off_t offset) {
+	return inode_write_cursor (inode, NULL, buffer_, size, offset);
+}
+
+/* Like inode_write_at(), looking sectors up through CURSOR. */
+off_t
+inode_write_cursor (struct inode *inode, struct inode_cursor *cursor,
+		const void *buffer_, off_t size, off_t offset) {
 	const uint8_t *buffer = buffer_;
 	off_t bytes_written = 0;
 	uint8_t *bounce = NULL;
 
-	if (inode->deny_write_cnt)
+	rwlock_acquire_read (&inode->rw);
+	bool denied = inode->deny_write_cnt > 0;
+	bool extend = offset + size > inode->data.length;
+	rwlock_release_read (&inode->rw);
+	if (denied)
 		return 0;
 
+	if (extend) {
+		bool extended = true;
+
+		rwlock_acquire_write (&inode->rw);
+		if (inode->deny_write_cnt > 0)
+			extended = false;
+		else if (offset + size > inode->data.length) {
+			extended = inode_allocate (&inode->data, offset + size);
+			sector_write (inode->sector, &inode->data);
+		}
+		rwlock_release_write (&inode->rw);
+		if (!extended)
+			return 0;
+	}
+
 	while (size > 0) {
-		/* Sector to write, starting byte offset within sector. */
-		disk_sector_t sector_idx = byte_to_sector (inode, offset);
+		/* Sector to write, starting byte offset within sector.  Past the
+		 * end of file it is one allocated above. */
+		rwlock_acquire_read (&inode->rw);
+		disk_sector_t sector_idx = cursor_to_sector (&inode->data, cursor,
+				offset / DISK_SECTOR_SIZE);
+		rwlock_release_read (&inode->rw);
 		int sector_ofs = offset % DISK_SECTOR_SIZE;
-
-		/* Bytes left in inode, bytes left in sector, lesser of the two. */
-		off_t inode_left = inode_length (inode) - offset;
 		int sector_left = DISK_SECTOR_SIZE - sector_ofs;
-		int min_left = inode_left < sector_left ? inode_left : sector_left;
 
 		/* Number of bytes to actually write into this sector. */
-		int chunk_size = size < min_left ? size : min_left;
-		if (chunk_size <= 0)
+		int chunk_size = size < sector_left ? size : sector_left;
+		if (sector_idx == NO_SECTOR)
 			break;
 
+#ifdef EFILESYS
+		/* The cache reads the sector in first only for a partial write.
+		 * User memory is copied into a bounce buffer before the cache
+		 * takes its lock, as in inode_read_at(). */
+		if (is_user_vaddr (buffer)) {
+			if (bounce == NULL) {
+				bounce = malloc (DISK_SECTOR_SIZE);
+				if (bounce == NULL)
+					break;
+			}
+			memcpy (bounce, buffer + bytes_written, chunk_size);
+			page_cache_write (sector_idx, bounce, sector_ofs, chunk_size);
+		} else
+			page_cache_write (sector_idx, buffer + bytes_written, sector_ofs, chunk_size);
+#else
 		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
 			/* Write full sector directly to disk. */
 			disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
@@ -276,6 +613,7 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 			memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
 			disk_write (filesys_disk, sector_idx, bounce); 
 		}
+#endif
 
 		/* Advance. */
 		size -= chunk_size;
@@ -284,6 +622,16 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 	}
 	free (bounce);
 
+	/* The data is in place, the file may grow now. */
+	if (extend && bytes_written > 0) {
+		rwlock_acquire_write (&inode->rw);
+		if (offset > inode->data.length) {
+			inode->data.length = offset;
+			sector_write (inode->sector, &inode->data);
+		}
+		rwlock_release_write (&inode->rw);
+	}
+
 	return bytes_written;
 }
 
@@ -292,8 +640,10 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 	void
 inode_deny_write (struct inode *inode) 
 {
+	rwlock_acquire_write (&inode->rw);
 	inode->deny_write_cnt++;
 	ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+	rwlock_release_write (&inode->rw);
 }
 
 /* Re-enables writes to INODE.
@@ -301,9 +651,11 @@ inode_deny_write (struct inode *inode)
  * inode_deny_write() on the inode, before closing the inode. */
 void
 inode_allow_write (struct inode *inode) {
+	rwlock_acquire_write (&inode->rw);
 	ASSERT (inode->deny_write_cnt > 0);
 	ASSERT (inode->deny_write_cnt <= inode->open_cnt);
 	inode->deny_write_cnt--;
+	rwlock_release_write (&inode->rw);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -1,6 +1,18 @@
 /* page_cache.c: Implementation of Page Cache (Buffer Cache). */
 
 #include "vm/vm.h"
+/* ------ Project 4 ------ */
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/fat.h"
+#include "filesys/filesys.h"
+#include "filesys/page_cache.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "threads/thread.h"
+
 static bool page_cache_readahead (struct page *page, void *kva);
 static bool page_cache_writeback (struct page *page);
 static void page_cache_destroy (struct page *page);
@@ -15,10 +27,81 @@ static const struct page_operations page_cache_op = {
 
 tid_t page_cache_workerd;
 
-/* The initializer of file vm */
+/* ------ Project 4 : Buffer Cache ------ */
+/* Every sector of filesys_disk that the file system reads or writes goes
+ * through a fixed array of PAGE_CACHE_SIZE sector buffers.  Replacement
+ * is the clock algorithm over the array.  Writes only mark the buffer
+ * dirty; dirty buffers reach the disk when they are evicted, when
+ * page_cache_kworkerd wakes up every PAGE_CACHE_FLUSH_TICKS, and on
+ * filesys_done.  A read of a sector also queues the next sector of the
+ * file for the read-ahead daemon.
+ *
+ * CACHE_LOCK protects the array and the copies into and out of the
+ * buffers, so callers pass kernel buffers only.  It is dropped for the
+ * disk transfer that fills or writes back a buffer: the entry is marked
+ * CACHE_READING or CACHE_WRITING meanwhile, eviction passes it over,
+ * and a thread that needs it waits on its IO_DONE.  Hits on other
+ * sectors proceed while a miss or a read-ahead is on the disk. */
+#define PAGE_CACHE_SIZE 64
+#define PAGE_CACHE_FLUSH_TICKS TIMER_FREQ
+#define READ_AHEAD_QUEUE 16
+
+/* Disk transfer in flight on a cache entry. */
+enum cache_io {
+  CACHE_IDLE,                 /* None. */
+  CACHE_READING,              /* Being filled; DATA is not valid yet. */
+  CACHE_WRITING,              /* Being written back; DATA must not change. */
+};
+
+struct cache_entry {
+  disk_sector_t sector;       /* Sector held, if VALID. */
+  bool valid;
+  bool dirty;                 /* Differs from the disk. */
+  bool accessed;              /* Used since the hand last passed. */
+  enum cache_io io;           /* Transfer in flight. */
+  struct condition io_done;   /* Signaled when IO returns to CACHE_IDLE. */
+  uint8_t data[DISK_SECTOR_SIZE];
+};
+
+static struct cache_entry cache[PAGE_CACHE_SIZE];
+static size_t cache_hand;           /* Clock hand, next entry to examine. */
+static struct lock cache_lock;
+static bool cache_ready;            /* page_cache_init has run. */
+
+/* Sectors waiting for the read-ahead daemon. */
+static disk_sector_t ra_queue[READ_AHEAD_QUEUE];
+static size_t ra_head, ra_tail;     /* Protected by CACHE_LOCK. */
+static struct semaphore ra_sema;    /* Up'd per queued sector. */
+
+/* Statistics. */
+static long long cache_hit_cnt;
+static long long cache_miss_cnt;
+static long long cache_writeback_cnt;
+static long long cache_ra_cnt;
+
+static void page_cache_kworkerd (void *aux);
+static void page_cache_ra_daemon (void *aux);
+
+/* Initialize the buffer cache and start its write-behind and read-ahead
+ * daemons.  Called by filesys_init before the file system touches the
+ * disk. */
 void
-pagecache_init (void) {
-	/* TODO: Create a worker daemon for page cache with page_cache_kworkerd */
+page_cache_init (void) {
+  for (size_t i = 0; i < PAGE_CACHE_SIZE; i++) {
+    cache[i].valid = false;
+    cache[i].dirty = false;
+    cache[i].accessed = false;
+    cache[i].io = CACHE_IDLE;
+    cond_init (&cache[i].io_done);
+  }
+  cache_hand = 0;
+  lock_init (&cache_lock);
+  ra_head = ra_tail = 0;
+  sema_init (&ra_sema, 0);
+  cache_ready = true;
+
+  page_cache_workerd = thread_create ("kworkerd", PRI_DEFAULT, page_cache_kworkerd, NULL);
+  thread_create ("readaheadd", PRI_DEFAULT, page_cache_ra_daemon, NULL);
 }
 
 /* Initialize the page cache */
@@ -44,7 +127,227 @@ static void
 page_cache_destroy (struct page *page) {
 }
 
+/* Ends the transfer in flight on E and wakes the threads waiting for
+ * it.  The caller must hold CACHE_LOCK. */
+static void
+cache_io_end (struct cache_entry *e) {
+  e->io = CACHE_IDLE;
+  cond_broadcast (&e->io_done, &cache_lock);
+}
+
+/* Write idle, dirty E back to the disk.  CACHE_LOCK, which the caller
+ * must hold, is released during the write. */
+static void
+cache_clean (struct cache_entry *e) {
+  ASSERT (e->valid && e->dirty && e->io == CACHE_IDLE);
+
+  e->io = CACHE_WRITING;
+  e->dirty = false;
+  lock_release (&cache_lock);
+  disk_write (filesys_disk, e->sector, e->data);
+  lock_acquire (&cache_lock);
+  cache_writeback_cnt++;
+  cache_io_end (e);
+}
+
+/* Fill E, just assigned its sector, from the disk.  CACHE_LOCK, which
+ * the caller must hold, is released during the read. */
+static void
+cache_fill (struct cache_entry *e) {
+  e->io = CACHE_READING;
+  lock_release (&cache_lock);
+  disk_read (filesys_disk, e->sector, e->data);
+  lock_acquire (&cache_lock);
+  cache_io_end (e);
+}
+
+/* Returns the entry holding SECTOR, or NULL.  The caller must hold
+ * CACHE_LOCK. */
+static struct cache_entry *
+cache_lookup (disk_sector_t sector) {
+  for (size_t i = 0; i < PAGE_CACHE_SIZE; i++) {
+    if (cache[i].valid && cache[i].sector == sector) {
+      return &cache[i];
+    }
+  }
+  return NULL;
+}
+
+/* Pick an idle entry with the clock and return it empty.  Returns NULL
+ * if CACHE_LOCK had to be released, to write a dirty victim back or to
+ * wait for a transfer because every entry had one in flight; the caller
+ * must then look its sector up again.  The caller must hold
+ * CACHE_LOCK. */
+static struct cache_entry *
+cache_evict (void) {
+  /* Two sweeps clear every accessed bit, so an idle entry turns up by
+     then unless all of them are busy. */
+  for (size_t n = 0; n < 2 * PAGE_CACHE_SIZE; n++) {
+    struct cache_entry *e = &cache[cache_hand];
+    cache_hand = (cache_hand + 1) % PAGE_CACHE_SIZE;
+
+    if (!e->valid) {
+      return e;
+    }
+    if (e->io != CACHE_IDLE) {
+      continue;
+    }
+    if (e->accessed) {
+      e->accessed = false;
+      continue;
+    }
+    if (e->dirty) {
+      /* Point the hand back at E, clean now unless someone used it
+         meanwhile. */
+      cache_clean (e);
+      cache_hand = e - cache;
+      return NULL;
+    }
+    e->valid = false;
+    return e;
+  }
+  cond_wait (&cache[cache_hand].io_done, &cache_lock);
+  return NULL;
+}
+
+/* Returns the entry for SECTOR, loading it unless the caller is about to
+ * overwrite it entirely (FILL false).  The entry is filled, and idle if
+ * the caller will WRITE it.  The caller must hold CACHE_LOCK. */
+static struct cache_entry *
+cache_get (disk_sector_t sector, bool fill, bool write) {
+  bool missed = false;
+
+  while (true) {
+    struct cache_entry *e = cache_lookup (sector);
+
+    if (e != NULL) {
+      if (e->io == CACHE_READING || (write && e->io == CACHE_WRITING)) {
+        cond_wait (&e->io_done, &cache_lock);
+        continue;
+      }
+      if (missed) {
+        cache_miss_cnt++;
+      }
+      else {
+        cache_hit_cnt++;
+      }
+      e->accessed = true;
+      return e;
+    }
+
+    missed = true;
+    e = cache_evict ();
+    if (e == NULL) {
+      continue;
+    }
+    cache_miss_cnt++;
+    e->sector = sector;
+    e->valid = true;
+    e->dirty = false;
+    e->accessed = true;
+    if (fill) {
+      cache_fill (e);
+    }
+    return e;
+  }
+}
+
+/* Copy SIZE bytes at offset OFS of SECTOR into BUFFER.  BUFFER must be
+ * kernel memory: the copy runs under CACHE_LOCK, and a fault on user
+ * memory could come back here. */
+void
+page_cache_read (disk_sector_t sector, void *buffer, int ofs, int size) {
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+  ASSERT (is_kernel_vaddr (buffer));
+
+  lock_acquire (&cache_lock);
+  struct cache_entry *e = cache_get (sector, true, false);
+  memcpy (buffer, e->data + ofs, size);
+  lock_release (&cache_lock);
+}
+
+/* Copy SIZE bytes from BUFFER to offset OFS of SECTOR.  BUFFER must be
+ * kernel memory, as for page_cache_read(). */
+void
+page_cache_write (disk_sector_t sector, const void *buffer, int ofs, int size) {
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+  ASSERT (is_kernel_vaddr (buffer));
+
+  lock_acquire (&cache_lock);
+  struct cache_entry *e = cache_get (sector, size < DISK_SECTOR_SIZE, true);
+  memcpy (e->data + ofs, buffer, size);
+  e->dirty = true;
+  lock_release (&cache_lock);
+}
+
+/* Ask the read-ahead daemon to bring SECTOR in.  Dropped if the queue is
+ * full or the sector is already cached. */
+void
+page_cache_prefetch (disk_sector_t sector) {
+  lock_acquire (&cache_lock);
+  if (cache_lookup (sector) == NULL
+      && (ra_tail + 1) % READ_AHEAD_QUEUE != ra_head) {
+    ra_queue[ra_tail] = sector;
+    ra_tail = (ra_tail + 1) % READ_AHEAD_QUEUE;
+    sema_up (&ra_sema);
+  }
+  lock_release (&cache_lock);
+}
+
+/* Write every dirty buffer back to the disk. */
+void
+page_cache_flush (void) {
+  if (!cache_ready) {
+    return;
+  }
+  lock_acquire (&cache_lock);
+  for (size_t i = 0; i < PAGE_CACHE_SIZE; i++) {
+    struct cache_entry *e = &cache[i];
+    if (e->valid && e->dirty && e->io == CACHE_IDLE) {
+      cache_clean (e);
+    }
+  }
+  lock_release (&cache_lock);
+}
+
+/* Prints buffer cache statistics. */
+void
+page_cache_print_stats (void) {
+  printf ("Buffer cache: %lld hits, %lld misses, %lld write-backs, %lld read ahead\n",
+      cache_hit_cnt, cache_miss_cnt, cache_writeback_cnt, cache_ra_cnt);
+}
+
 /* Worker thread for page cache */
 static void
-page_cache_kworkerd (void *aux) {
+page_cache_kworkerd (void *aux UNUSED) {
+  while (true) {
+    timer_sleep (PAGE_CACHE_FLUSH_TICKS);
+    page_cache_flush ();
+    fat_flush ();
+  }
+}
+
+/* Loads the sectors queued by page_cache_prefetch. */
+static void
+page_cache_ra_daemon (void *aux UNUSED) {
+  while (true) {
+    sema_down (&ra_sema);
+
+    lock_acquire (&cache_lock);
+    disk_sector_t sector = ra_queue[ra_head];
+    ra_head = (ra_head + 1) % READ_AHEAD_QUEUE;
+    while (cache_lookup (sector) == NULL) {
+      struct cache_entry *e = cache_evict ();
+      if (e == NULL) {
+        continue;
+      }
+      e->sector = sector;
+      e->valid = true;
+      e->dirty = false;
+      e->accessed = false;
+      cache_fill (e);
+      cache_ra_cnt++;
+    }
+    lock_release (&cache_lock);
+  }
 }
@@ -2,6 +2,9 @@
 #define DEVICES_DISK_H
 
 #include <inttypes.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /* Size of a disk sector in bytes. */
@@ -15,6 +18,9 @@ typedef uint32_t disk_sector_t;
  * printf ("sector=%"PRDSNu"\n", sector); */
 #define PRDSNu PRIu32
 
+/* -mult: Sectors per DRQ block for READ/WRITE MULTIPLE. */
+extern unsigned disk_multiple_max;
+
 void disk_init (void);
 void disk_print_stats (void);
 
@@ -23,5 +29,19 @@ disk_sector_t disk_size (struct disk *);
 void disk_read (struct disk *, disk_sector_t, void *);
 void disk_write (struct disk *, disk_sector_t, const void *);
 
+/* An asynchronous request for CNT sectors starting at SECTOR. */
+struct disk_request {
+	struct disk *disk;
+	disk_sector_t sector;
+	size_t cnt;                 /* At most 256. */
+	void *buffer;               /* Kernel address. */
+	bool write;
+	void (*complete) (struct disk_request *);   /* May be null. */
+	void *aux;                  /* For COMPLETE's use. */
+	struct list_elem elem;      /* Channel queue element. */
+};
+
+void disk_submit (struct disk_request *);
+
 void 	register_disk_inspect_intr ();
 #endif /* devices/disk.h */
@@ -7,6 +7,14 @@
 
 struct bitmap;
 
+/* Copy of the index block an open file was last read or written
+ * through, so that a pass over a large file reads each index block
+ * once instead of for every sector.  All zeros is an empty cursor. */
+struct inode_cursor {
+	size_t first;                       /* Sector number of SLOTS[0]. */
+	disk_sector_t slots[DISK_SECTOR_SIZE / sizeof (disk_sector_t)];
+};
+
 void inode_init (void);
 bool inode_create (disk_sector_t, off_t);
 struct inode *inode_open (disk_sector_t);
@@ -14,8 +22,14 @@ struct inode *inode_reopen (struct inode *);
 disk_sector_t inode_get_inumber (const struct inode *);
 void inode_close (struct inode *);
 void inode_remove (struct inode *);
+void inode_lock (struct inode *);
+void inode_unlock (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+off_t inode_read_cursor (struct inode *, struct inode_cursor *, void *,
+		off_t size, off_t offset);
+off_t inode_write_cursor (struct inode *, struct inode_cursor *, const void *,
+		off_t size, off_t offset);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
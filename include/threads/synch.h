@@ -44,6 +44,23 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Readers-writer lock.  Any number of readers or a single writer
+   hold it at once.  A waiting writer keeps new readers out, so
+   writers are not starved. */
+struct rwlock {
+	struct lock lock;           /* Protects the fields below. */
+	struct condition changed;   /* Signaled when the lock frees up. */
+	int readers;                /* Readers holding the lock. */
+	int waiting_writers;        /* Writers waiting for it. */
+	struct thread *writer;      /* Writer holding it, if any. */
+};
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+
 /* Optimization barrier.
  *
  * The compiler will not reorder operations across an
@@ -97,10 +97,10 @@ struct thread {
   char name[16];                      /* Name (for debugging purposes). */
   int priority;                       /* Priority. */
   int origin_priority;                //* 본래 priority
+  int ready_priority;                 /* Run queue holding us, while ready. */
 
 	/* Shared between thread.c and synch.c. */
 	struct list_elem elem;              /* List element. */
-  struct list_elem a_elem;            //* MLFQS
   int64_t waken_ticks;
 
   struct lock *wait_on_lock;          //* 내가 기다리고 있는 lock (nest 처리를 위해)
@@ -109,6 +109,9 @@ struct thread {
 
   int recent_cpu;                     //* 내가 최근에 cpu를 점유한 틱
   int nice;                           //* 내가 다른 스레드들에게 얼마나 CPU를 양보했는지 (상대 지수)
+  int64_t decay_epoch;                /* Seconds of recent_cpu decay applied. */
+  struct list_elem decay_elem;        /* decay_parked list, while blocked. */
+  bool decay_parked;                  /* In a decay_parked list? */
 
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
@@ -149,6 +152,7 @@ void thread_init (void);
 void thread_start (void);
 
 void thread_tick (void);
+void thread_idle_ticks (int64_t n);
 void thread_print_stats (void);
 
 typedef void thread_func (void *aux);
@@ -159,6 +163,7 @@ void thread_block (void);
 void thread_unblock (struct thread *);
 void thread_sleep(int64_t alarm_ticks);
 void thread_wakeup(int64_t alarm_ticks);
+int64_t thread_next_wakeup (void);
 
 struct thread *thread_current (void);
 tid_t thread_tid (void);
@@ -167,6 +172,7 @@ const char *thread_name (void);
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
 void thread_preemption (void);
+void thread_requeue (struct thread *);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
@@ -21,8 +21,6 @@ typedef int off_t;
 #define EXIT_SUCCESS 0          /* Successful execution. */
 #define EXIT_FAILURE 1          /* Unsuccessful execution. */
 
-struct lock filesys_lock;
-
 static void check_addr (const char *file);
 static void check_with_writable (const char *file);
 
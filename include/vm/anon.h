@@ -1,6 +1,7 @@
 #ifndef VM_ANON_H
 #define VM_ANON_H
 #include "vm/vm.h"
+#include "vm/zswap.h"
 struct page;
 enum vm_type;
 
@@ -9,10 +10,17 @@ struct anon_page {
   enum vm_type type;
   void *aux;
 
-  int swap_idx;
+  int swap_idx;               /* Swap slot, or one of the SWAP_IDX_* below */
+  struct zswap_entry zswap;   /* Where the page is when in the zswap arena */
 };
 
+#define SWAP_IDX_NONE (-1)      /* Resident */
+#define SWAP_IDX_ZSWAP (-2)     /* Held by the compressed tier */
+
+extern const char *swap_layout;
+
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+void swap_print_stats (void);
 
 #endif
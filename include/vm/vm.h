@@ -5,10 +5,12 @@
 /* ------ Project 3 ------ */
 #include "lib/kernel/hash.h"
 #include <stdlib.h>
+#include "threads/synch.h"
 /* ----------------------- */
 
-struct list framelist;
-struct lock spt_lock;
+/* Page-out daemon watermarks, in free user pages. */
+extern size_t vm_low_watermark;
+extern size_t vm_high_watermark;
 
 enum vm_type {
 	/* page not initialized */
@@ -34,6 +36,7 @@ enum vm_type {
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
+#include "vm/vma.h"
 #ifdef EFILESYS
 #include "filesys/page_cache.h"
 #endif
@@ -54,7 +57,10 @@ struct page {
 
   /* ------ Project 3 ------ */
   struct hash_elem h_elem;
-  uint32_t file_length;
+  struct thread *owner;  /* Thread whose pml4 maps this page */
+  struct list_elem s_elem;  /* Element in frame->pages */
+  struct vma *vma;          /* Area this page belongs to, if any */
+  struct list_elem v_elem;  /* Element in vma->pages */
 
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -74,7 +80,10 @@ struct frame {
   struct page *page;
 
   /* ------ Project 3 ------ */
-  struct list_elem f_elem;
+  struct list_elem f_elem;   /* Element in the frame table (clock ring) */
+  struct list pages;         /* Pages mapping this frame, `page' is the front */
+  int ref_cnt;               /* # of pages sharing this frame (copy-on-write) */
+  bool evicting;             /* Pages being written out, see vm_evict_frame */
 };
 
 /* The function table for page operations.
@@ -98,6 +107,14 @@ struct page_operations {
  * All designs up to you for this. */
 struct supplemental_page_table {
   struct hash spt_hash;
+  struct lock lock;       /* Held by writers and by readers other than the owner */
+  struct vma_table vmas;  /* mmap and segment areas, pages made on demand */
+
+  /* Fault-around state for file-backed lazy pages. */
+  void *ra_next;      /* First page past the last fault-around window */
+  size_t ra_window;   /* Pages to load on the next fault */
+
+  size_t swap_next;   /* Swap slot after the last one this process used */
 };
 
 #include "threads/thread.h"
@@ -107,6 +124,7 @@ bool supplemental_page_table_copy (struct supplemental_page_table *dst,
 void supplemental_page_table_kill (struct supplemental_page_table *spt);
 struct page *spt_find_page (struct supplemental_page_table *spt,
 		void *va);
+struct page *vm_get_page (struct thread *owner, void *va);
 bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
 
@@ -126,6 +144,8 @@ enum vm_type page_get_type (struct page *page);
 unsigned page_hash (const struct hash_elem *p_, void *aux UNUSED);
 bool page_less (const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED);
 struct page * page_lookup (const void *address, struct supplemental_page_table *spt);
+void vm_free_frame (struct page *page);
+void vm_print_stats (void);
 
 void print_spt(void);
 
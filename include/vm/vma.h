@@ -0,0 +1,44 @@
+#ifndef VM_VMA_H
+#define VM_VMA_H
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "vm/vm.h"
+
+struct file;
+
+/* A virtual memory area: a page-aligned range of user addresses whose
+ * contents come from FILE, recorded once by mmap or by the ELF loader.
+ * The struct page objects of the area are created on first access. */
+struct vma {
+  void *start;             /* First page of the area */
+  void *end;               /* One past the last page */
+  enum vm_type type;       /* VM_FILE for mmap, VM_ANON for segments */
+  bool writable;
+  struct file *file;       /* Owned by the area, closed on removal */
+  off_t ofs;               /* File offset of START */
+  size_t read_bytes;       /* Bytes that come from FILE, the rest is zero */
+  struct list pages;       /* Pages created so far (page->v_elem) */
+};
+
+/* The areas of one process, kept sorted by start address so lookups are
+ * a binary search. */
+struct vma_table {
+  struct vma **areas;
+  size_t cnt;
+  size_t cap;
+};
+
+void vma_table_init (struct vma_table *vt);
+bool vma_table_copy (struct vma_table *dst, struct vma_table *src);
+void vma_table_kill (struct vma_table *vt);
+
+struct vma *vma_create (struct vma_table *vt, void *start, size_t length,
+    enum vm_type type, bool writable, struct file *file, off_t ofs,
+    size_t read_bytes);
+void vma_remove (struct vma_table *vt, struct vma *vma);
+struct vma *vma_find (struct vma_table *vt, const void *va);
+bool vma_overlaps (struct vma_table *vt, const void *start, const void *end);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Where a page parked in the compressed tier lives. */
+struct zswap_entry {
+  int chunk;            /* First arena chunk, or one of the ZSWAP_* below */
+  uint16_t len;         /* Compressed length in bytes */
+  uint64_t fill;        /* Repeated word of a same-filled page */
+  size_t slot;          /* Swap slot, once written back */
+  bool writeback;       /* Being written back to the swap disk */
+  struct list_elem lru_elem;  /* Arena LRU list, while in the arena */
+};
+
+#define ZSWAP_SAME (-1)         /* Same-filled, no arena space */
+#define ZSWAP_ON_DISK (-2)      /* Written back to swap slot SLOT */
+
+/* No swap slot: zswap_load served the page, zswap_free had none. */
+#define ZSWAP_NO_SLOT SIZE_MAX
+
+/* Outcome of zswap_store. */
+enum zswap_result {
+  ZSWAP_STORED,         /* Page is in the compressed tier */
+  ZSWAP_REJECTED,       /* Page does not compress well enough */
+  ZSWAP_FULL,           /* No room left in the arena */
+};
+
+/* Size of the compressed arena in kernel pages, 0 disables the tier. */
+extern size_t zswap_pages;
+
+void zswap_init (void);
+enum zswap_result zswap_store (const void *kva, struct zswap_entry *entry);
+size_t zswap_load (struct zswap_entry *entry, void *kva);
+size_t zswap_free (struct zswap_entry *entry);
+struct zswap_entry *zswap_writeback_begin (void *kva);
+void zswap_writeback_end (struct zswap_entry *entry, size_t slot);
+void zswap_note_disk_read (void);
+void zswap_print_stats (void);
+
+#endif
@@ -0,0 +1,49 @@
+/* Child process for syn-files test.
+   Creates a file of its own, grows it one chunk at a time, reads
+   it back and removes it, ROUND_CNT times.  Other processes are
+   doing the same with their files in the same directory. */
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/base/syn-files.h"
+
+static char buf[BUF_SIZE];
+
+int
+main (int argc, char *argv[])
+{
+  char file_name[16];
+  int child_idx;
+  int round;
+
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+  snprintf (file_name, sizeof file_name, "file%d", child_idx);
+
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      size_t ofs;
+      int fd;
+
+      random_init (child_idx * ROUND_CNT + round);
+      random_bytes (buf, sizeof buf);
+
+      CHECK (create (file_name, 0), "create \"%s\"", file_name);
+      CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+      for (ofs = 0; ofs < BUF_SIZE; ofs += CHUNK_SIZE)
+        CHECK (write (fd, buf + ofs, CHUNK_SIZE) == CHUNK_SIZE,
+               "write %d bytes at offset %zu in \"%s\"",
+               CHUNK_SIZE, ofs, file_name);
+      check_file_handle (fd, file_name, buf, sizeof buf);
+      msg ("close \"%s\"", file_name);
+      close (fd);
+      CHECK (remove (file_name), "remove \"%s\"", file_name);
+    }
+
+  return child_idx;
+}
@@ -0,0 +1,17 @@
+/* Spawns several child processes that each create, grow, read back
+   and remove files of their own in the same directory, all at the
+   same time, and waits for them to finish. */
+
+#include <syscall.h>
+#include "tests/filesys/base/syn-files.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+
+  exec_children ("child-syn-files", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(syn-files) begin
+(syn-files) exec child 1 of 4: "child-syn-files 0"
+(syn-files) exec child 2 of 4: "child-syn-files 1"
+(syn-files) exec child 3 of 4: "child-syn-files 2"
+(syn-files) exec child 4 of 4: "child-syn-files 3"
+(syn-files) wait for child 1 of 4 returned 0 (expected 0)
+(syn-files) wait for child 2 of 4 returned 1 (expected 1)
+(syn-files) wait for child 3 of 4 returned 2 (expected 2)
+(syn-files) wait for child 4 of 4 returned 3 (expected 3)
+(syn-files) end
+EOF
+pass;
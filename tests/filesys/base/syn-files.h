@@ -0,0 +1,9 @@
+#ifndef TESTS_FILESYS_BASE_SYN_FILES_H
+#define TESTS_FILESYS_BASE_SYN_FILES_H
+
+#define CHILD_CNT 4
+#define ROUND_CNT 3
+#define CHUNK_SIZE 512
+#define BUF_SIZE (16 * CHUNK_SIZE)
+
+#endif /* tests/filesys/base/syn-files.h */
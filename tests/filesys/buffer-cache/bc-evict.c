@@ -0,0 +1,67 @@
+/* Grows a file several times larger than the buffer cache in chunks
+   that straddle sector boundaries, so that dirty buffers are written
+   back on eviction while others are being filled, then reads it back
+   backwards and checks every byte.  A small file read twice must then
+   be served by the cache the second time. */
+
+#include <random.h>
+#include <string.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BIG_SIZE (128 * 1024)
+#define SMALL_SIZE (16 * 512)
+#define CHUNK_SIZE 700
+
+static char buf[BIG_SIZE];
+static char rbuf[BIG_SIZE];
+
+void
+test_main (void) {
+  int fd;
+  size_t ofs;
+  long long read_cnt;
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+
+  CHECK (create ("big", 0), "create \"big\"");
+  CHECK ((fd = open ("big")) > 1, "open \"big\"");
+  for (ofs = 0; ofs < BIG_SIZE; ofs += CHUNK_SIZE) {
+    size_t size = BIG_SIZE - ofs < CHUNK_SIZE ? BIG_SIZE - ofs : CHUNK_SIZE;
+    if (write (fd, buf + ofs, size) != (int) size)
+      fail ("write %zu bytes at offset %zu in \"big\" failed", size, ofs);
+  }
+  msg ("write \"big\" in %d-byte chunks", CHUNK_SIZE);
+
+  for (ofs = BIG_SIZE / CHUNK_SIZE * CHUNK_SIZE; ; ofs -= CHUNK_SIZE) {
+    size_t size = BIG_SIZE - ofs < CHUNK_SIZE ? BIG_SIZE - ofs : CHUNK_SIZE;
+    seek (fd, ofs);
+    if (read (fd, rbuf + ofs, size) != (int) size)
+      fail ("read %zu bytes at offset %zu in \"big\" failed", size, ofs);
+    if (ofs == 0)
+      break;
+  }
+  for (ofs = 0; ofs < BIG_SIZE; ofs++)
+    if (rbuf[ofs] != buf[ofs])
+      fail ("file content mismatch at offset %zu", ofs);
+  msg ("read \"big\" backwards");
+  msg ("close \"big\"");
+  close (fd);
+
+  CHECK (create ("small", SMALL_SIZE), "create \"small\"");
+  CHECK ((fd = open ("small")) > 1, "open \"small\"");
+  CHECK (write (fd, buf, SMALL_SIZE) == SMALL_SIZE, "write \"small\"");
+  seek (fd, 0);
+  CHECK (read (fd, rbuf, SMALL_SIZE) == SMALL_SIZE, "read \"small\"");
+  read_cnt = get_fs_disk_read_cnt ();
+  seek (fd, 0);
+  CHECK (read (fd, rbuf, SMALL_SIZE) == SMALL_SIZE, "read \"small\" again");
+  CHECK (get_fs_disk_read_cnt () == read_cnt, "check read_cnt");
+  if (memcmp (rbuf, buf, SMALL_SIZE))
+    fail ("\"small\" content mismatch");
+  msg ("close \"small\"");
+  close (fd);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(bc-evict) begin
+(bc-evict) create "big"
+(bc-evict) open "big"
+(bc-evict) write "big" in 700-byte chunks
+(bc-evict) read "big" backwards
+(bc-evict) close "big"
+(bc-evict) create "small"
+(bc-evict) open "small"
+(bc-evict) write "small"
+(bc-evict) read "small"
+(bc-evict) read "small" again
+(bc-evict) check read_cnt
+(bc-evict) close "small"
+(bc-evict) end
+EOF
+pass;
@@ -0,0 +1,91 @@
+/* Checks that sleeping works while the whole system is idle, when
+   the timer may let several ticks pass between interrupts.
+
+   THREAD_CNT threads each sleep a different, long period with
+   nothing else to run.  Each must wake up in order, no earlier
+   than asked and at most one tick late, which also means the
+   ticks skipped while idle were counted. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 5
+
+struct sleeper 
+  {
+    int64_t duration;           /* Ticks to sleep. */
+    int64_t elapsed;            /* Ticks actually slept. */
+    int order;                  /* Position in the wake-up order. */
+  };
+
+static struct sleeper sleepers[THREAD_CNT];
+static struct lock order_lock;
+static int woken_cnt;
+static struct semaphore done;
+
+static thread_func sleeper_thread;
+
+void
+test_alarm_tickless (void) 
+{
+  int64_t start;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  lock_init (&order_lock);
+  sema_init (&done, 0);
+  woken_cnt = 0;
+
+  /* Create the threads longest sleeper first, so that wake-up
+     order differs from creation order. */
+  start = timer_ticks ();
+  for (i = THREAD_CNT - 1; i >= 0; i--) 
+    {
+      char name[16];
+
+      sleepers[i].duration = 40 * (i + 1) + 7;
+      snprintf (name, sizeof name, "sleeper %d", i);
+      thread_create (name, PRI_DEFAULT, sleeper_thread, &sleepers[i]);
+    }
+
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      struct sleeper *s = &sleepers[i];
+
+      if (s->order != i)
+        fail ("thread %d woke up in position %d", i, s->order);
+      if (s->elapsed < s->duration || s->elapsed > s->duration + 1)
+        fail ("thread %d slept %"PRId64" ticks instead of %"PRId64,
+              i, s->elapsed, s->duration);
+      msg ("thread %d woke up on time.", i);
+    }
+
+  if (timer_elapsed (start) < sleepers[THREAD_CNT - 1].duration)
+    fail ("only %"PRId64" ticks passed in all", timer_elapsed (start));
+}
+
+static void
+sleeper_thread (void *s_) 
+{
+  struct sleeper *s = s_;
+  int64_t start = timer_ticks ();
+
+  timer_sleep (s->duration);
+  s->elapsed = timer_elapsed (start);
+
+  lock_acquire (&order_lock);
+  s->order = woken_cnt++;
+  lock_release (&order_lock);
+
+  sema_up (&done);
+}
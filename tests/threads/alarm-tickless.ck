@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-tickless) begin
+(alarm-tickless) thread 0 woke up on time.
+(alarm-tickless) thread 1 woke up on time.
+(alarm-tickless) thread 2 woke up on time.
+(alarm-tickless) thread 3 woke up on time.
+(alarm-tickless) thread 4 woke up on time.
+(alarm-tickless) end
+EOF
+pass;
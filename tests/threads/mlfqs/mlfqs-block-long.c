@@ -0,0 +1,65 @@
+/* Checks that recent_cpu keeps decaying for a thread that stays
+   blocked longer than the scheduler keeps per-second decay
+   history for (64 seconds).
+
+   The "block" thread spins for 10 seconds, building up
+   recent_cpu, then sleeps for 70 seconds while the main thread
+   spins and keeps the load average up.  If every second of decay
+   is applied while it sleeps, the block thread wakes up with a
+   recent_cpu near 0 instead of the 100 or so it went to sleep
+   with. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static void block_thread (void *done_);
+
+void
+test_mlfqs_block_long (void) 
+{
+  struct semaphore done;
+
+  ASSERT (thread_mlfqs);
+
+  sema_init (&done, 0);
+
+  msg ("Main thread creating block thread, sleeping 11 seconds...");
+  thread_create ("block", PRI_DEFAULT, block_thread, &done);
+  timer_sleep (11 * TIMER_FREQ);
+
+  msg ("Main thread spinning until the block thread wakes up...");
+  while (!sema_try_down (&done))
+    continue;
+
+  msg ("Main thread done.");
+}
+
+static void
+block_thread (void *done_) 
+{
+  struct semaphore *done = done_;
+  int64_t start_time;
+  int recent_cpu;
+
+  msg ("Block thread spinning for 10 seconds...");
+  start_time = timer_ticks ();
+  while (timer_elapsed (start_time) < 10 * TIMER_FREQ)
+    continue;
+
+  msg ("Block thread sleeping for 70 seconds...");
+  timer_sleep (70 * TIMER_FREQ);
+
+  /* A few ticks of our own may have been charged since waking. */
+  recent_cpu = thread_get_recent_cpu ();
+  if (recent_cpu > 500)
+    fail ("recent_cpu is %d.%02d after sleeping, should be near 0",
+          recent_cpu / 100, recent_cpu % 100);
+  msg ("Block thread woke up with recent_cpu decayed.");
+
+  sema_up (done);
+}
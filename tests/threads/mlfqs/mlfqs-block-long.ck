@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(mlfqs-block-long) begin
+(mlfqs-block-long) Main thread creating block thread, sleeping 11 seconds...
+(mlfqs-block-long) Block thread spinning for 10 seconds...
+(mlfqs-block-long) Block thread sleeping for 70 seconds...
+(mlfqs-block-long) Main thread spinning until the block thread wakes up...
+(mlfqs-block-long) Block thread woke up with recent_cpu decayed.
+(mlfqs-block-long) Main thread done.
+(mlfqs-block-long) end
+EOF
+pass;
@@ -0,0 +1,69 @@
+/* Checks that threads of equal priority run in FIFO order and
+   that a ready thread whose priority is raised by donation moves
+   ahead of the threads it was queued with.
+
+   Thread "holder" takes a lock and drops to priority 20, then
+   threads "a" and "b" queue behind it at priority 20.  Thread
+   "donor", at priority 40, blocks on the lock, which must move
+   "holder" from the priority 20 queue straight to the CPU.  Once
+   it gives the donation back, "holder" queues again behind "a"
+   and "b". */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func holder_thread;
+static thread_func donor_thread;
+static thread_func simple_thread;
+
+static struct lock lock;
+
+void
+test_priority_requeue (void) 
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  lock_init (&lock);
+  thread_create ("holder", PRI_DEFAULT + 1, holder_thread, NULL);
+  thread_create ("a", 20, simple_thread, NULL);
+  thread_create ("b", 20, simple_thread, NULL);
+  thread_create ("donor", 40, donor_thread, NULL);
+  msg ("Main thread lowering its priority to 10.");
+  thread_set_priority (10);
+  msg ("Main thread done.");
+}
+
+static void
+holder_thread (void *aux UNUSED) 
+{
+  lock_acquire (&lock);
+  msg ("Thread holder got the lock, dropping to priority 20.");
+  thread_set_priority (20);
+  msg ("Thread holder releasing the lock at priority %d.",
+       thread_get_priority ());
+  lock_release (&lock);
+  msg ("Thread holder done.");
+}
+
+static void
+donor_thread (void *aux UNUSED) 
+{
+  msg ("Thread donor acquiring the lock.");
+  lock_acquire (&lock);
+  msg ("Thread donor got the lock.");
+  lock_release (&lock);
+  msg ("Thread donor done.");
+}
+
+static void
+simple_thread (void *aux UNUSED) 
+{
+  msg ("Thread %s running.", thread_name ());
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-requeue) begin
+(priority-requeue) Thread holder got the lock, dropping to priority 20.
+(priority-requeue) Thread donor acquiring the lock.
+(priority-requeue) Thread holder releasing the lock at priority 40.
+(priority-requeue) Thread donor got the lock.
+(priority-requeue) Thread donor done.
+(priority-requeue) Main thread lowering its priority to 10.
+(priority-requeue) Thread a running.
+(priority-requeue) Thread b running.
+(priority-requeue) Thread holder done.
+(priority-requeue) Main thread done.
+(priority-requeue) end
+EOF
+pass;
@@ -0,0 +1,45 @@
+/* Checks that a read() system call into a page the child still shares
+   with its parent gives the child its own frame, instead of the kernel
+   writing the file data into the shared one. */
+
+#include <string.h>
+#include <syscall.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+
+static char buf[PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+void
+test_main (void)
+{
+	pid_t child;
+	void *pa_parent;
+	int handle;
+	size_t i;
+
+	memset (buf, '#', sizeof buf);
+	pa_parent = get_phys_addr (buf);
+
+	child = fork ("child");
+	if (child == 0) {
+		CHECK (get_phys_addr (buf) == pa_parent, "page is shared after fork");
+		CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+		CHECK (read (handle, buf, sizeof sample - 1) == (int) sizeof sample - 1,
+				"read \"sample.txt\" into the shared page");
+		CHECK (memcmp (buf, sample, sizeof sample - 1) == 0,
+				"child sees the file data");
+		CHECK (get_phys_addr (buf) != pa_parent, "read page got its own frame");
+		close (handle);
+		return;
+	}
+	wait (child);
+	for (i = 0; i < sizeof buf; i++)
+		if (buf[i] != '#')
+			fail ("parent byte %zu changed to %02hhx", i, buf[i]);
+	msg ("parent page is unchanged");
+}
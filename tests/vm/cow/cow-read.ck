@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(cow-read) begin
+(cow-read) page is shared after fork
+(cow-read) open "sample.txt"
+(cow-read) read "sample.txt" into the shared page
+(cow-read) child sees the file data
+(cow-read) read page got its own frame
+(cow-read) end
+(cow-read) parent page is unchanged
+(cow-read) end
+EOF
+pass;
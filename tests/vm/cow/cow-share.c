@@ -0,0 +1,52 @@
+/* Checks that fork shares every resident page with the child and that a
+   write fault copies only the page being written */
+
+#include <string.h>
+#include <syscall.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_COUNT 16
+
+static char buf[PAGE_COUNT * PAGE_SIZE];
+static void *pa_parent[PAGE_COUNT];
+
+void
+test_main (void)
+{
+	pid_t child;
+	size_t i;
+	bool shared;
+
+	for (i = 0; i < PAGE_COUNT; i++) {
+		buf[i * PAGE_SIZE] = (char) i;
+		pa_parent[i] = get_phys_addr (&buf[i * PAGE_SIZE]);
+	}
+
+	child = fork ("child");
+	if (child == 0) {
+		shared = true;
+		for (i = 0; i < PAGE_COUNT; i++)
+			if (get_phys_addr (&buf[i * PAGE_SIZE]) != pa_parent[i])
+				shared = false;
+		CHECK (shared, "all pages are shared after fork");
+
+		buf[0] = '@';
+		CHECK (get_phys_addr (&buf[0]) != pa_parent[0],
+				"written page got its own frame");
+
+		shared = true;
+		for (i = 1; i < PAGE_COUNT; i++)
+			if (get_phys_addr (&buf[i * PAGE_SIZE]) != pa_parent[i]
+					|| buf[i * PAGE_SIZE] != (char) i)
+				shared = false;
+		CHECK (shared, "untouched pages are still shared");
+		return;
+	}
+	wait (child);
+	CHECK (get_phys_addr (&buf[0]) == pa_parent[0] && buf[0] == 0,
+			"parent page is unchanged");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(cow-share) begin
+(cow-share) all pages are shared after fork
+(cow-share) written page got its own frame
+(cow-share) untouched pages are still shared
+(cow-share) end
+(cow-share) parent page is unchanged
+(cow-share) end
+EOF
+pass;
@@ -0,0 +1,39 @@
+/* Checks that a read() system call into an anonymous page that was
+   only read so far, and so maps the shared zero frame, gives the page
+   its own frame and leaves other untouched pages zero. */
+
+#include <string.h>
+#include <syscall.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+
+static char buf[2][PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+void
+test_main (void)
+{
+	int handle;
+	size_t i;
+
+	CHECK (buf[0][0] == 0 && buf[1][0] == 0, "untouched pages read as zero");
+	CHECK (get_phys_addr (buf[0]) == get_phys_addr (buf[1]),
+			"untouched pages share a frame");
+
+	CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+	CHECK (read (handle, buf[0], sizeof sample - 1) == (int) sizeof sample - 1,
+			"read \"sample.txt\" into the first page");
+	CHECK (memcmp (buf[0], sample, sizeof sample - 1) == 0,
+			"first page has the file data");
+	CHECK (get_phys_addr (buf[0]) != get_phys_addr (buf[1]),
+			"first page got its own frame");
+	for (i = 0; i < PAGE_SIZE; i++)
+		if (buf[1][i] != 0)
+			fail ("byte %zu of the second page is %02hhx", i, buf[1][i]);
+	msg ("second page is still zero");
+	close (handle);
+}
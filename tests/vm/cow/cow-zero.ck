@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(cow-zero) begin
+(cow-zero) untouched pages read as zero
+(cow-zero) untouched pages share a frame
+(cow-zero) open "sample.txt"
+(cow-zero) read "sample.txt" into the first page
+(cow-zero) first page has the file data
+(cow-zero) first page got its own frame
+(cow-zero) second page is still zero
+(cow-zero) end
+EOF
+pass;
@@ -0,0 +1,59 @@
+/* Keeps a few pages hot while sweeping a region larger than memory,
+ * so that eviction has to pass over recently used pages.  The hot
+ * pages are checked and rewritten every 64 swept pages, and the swept
+ * pages are checked on the next sweep; neither may lose its contents.
+ * For this test, Pintos memory size is 10MB. */
+
+#include <string.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SHIFT 12
+#define PAGE_SIZE (1 << PAGE_SHIFT)
+#define ONE_MB (1 << 20) // 1MB
+#define CHUNK_SIZE (16*ONE_MB)
+#define PAGE_COUNT (CHUNK_SIZE / PAGE_SIZE)
+#define HOT_COUNT 16
+#define SWEEP_COUNT 3
+
+static char big_chunks[CHUNK_SIZE];
+static char hot_pages[HOT_COUNT * PAGE_SIZE];
+static int hot_round;
+
+/* Checks that every hot page holds HOT_ROUND, then advances it. */
+static void
+touch_hot (void)
+{
+    size_t i;
+
+    for (i = 0 ; i < HOT_COUNT ; i++) {
+        int *hot = (int *) (hot_pages + i * PAGE_SIZE);
+        if (*hot != hot_round)
+            fail ("hot page %zu lost its contents", i);
+        *hot = hot_round + 1;
+    }
+    hot_round++;
+}
+
+void
+test_main (void)
+{
+    size_t i;
+    int sweep;
+
+    for (sweep = 0 ; sweep < SWEEP_COUNT ; sweep++) {
+        msg ("sweep %d", sweep);
+        for (i = 0 ; i < PAGE_COUNT ; i++) {
+            char *mem = big_chunks + i * PAGE_SIZE;
+            if (sweep > 0 && *mem != (char) (i + sweep - 1))
+                fail ("data is inconsistent in page %zu", i);
+            *mem = (char) (i + sweep);
+            if (i % 64 == 0)
+                touch_hot ();
+        }
+    }
+    touch_hot ();
+    msg ("hot pages kept their contents");
+}
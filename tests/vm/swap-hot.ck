@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-hot) begin
+(swap-hot) sweep 0
+(swap-hot) sweep 1
+(swap-hot) sweep 2
+(swap-hot) hot pages kept their contents
+(swap-hot) end
+EOF
+pass;
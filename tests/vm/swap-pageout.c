@@ -0,0 +1,50 @@
+/* Rewrites pages while the page-out daemon is evicting them.  The
+ * kernel runs with watermarks that keep pageoutd busy, so a store
+ * often hits a page whose frame is being written out, and must wait
+ * for the write and fault the page back in.  Every page is written,
+ * checked and rewritten, then checked again.
+ * For this test, Pintos memory size is 10MB. */
+
+#include <string.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SHIFT 12
+#define PAGE_SIZE (1 << PAGE_SHIFT)
+#define ONE_MB (1 << 20) // 1MB
+#define CHUNK_SIZE (12*ONE_MB)
+#define PAGE_COUNT (CHUNK_SIZE / PAGE_SIZE)
+
+static char big_chunks[CHUNK_SIZE];
+
+void
+test_main (void)
+{
+    size_t i;
+    char *mem;
+
+    msg ("write every page");
+    for (i = 0 ; i < PAGE_COUNT ; i++) {
+        mem = big_chunks + i * PAGE_SIZE;
+        mem[0] = (char) i;
+        mem[PAGE_SIZE - 1] = (char) ~i;
+    }
+
+    msg ("check and rewrite every page");
+    for (i = 0 ; i < PAGE_COUNT ; i++) {
+        mem = big_chunks + i * PAGE_SIZE;
+        if (mem[0] != (char) i || mem[PAGE_SIZE - 1] != (char) ~i)
+            fail ("data is inconsistent in page %zu", i);
+        mem[0] = (char) (i * 3);
+        mem[PAGE_SIZE - 1] = (char) (i * 5);
+    }
+
+    msg ("check every page again");
+    for (i = 0 ; i < PAGE_COUNT ; i++) {
+        mem = big_chunks + i * PAGE_SIZE;
+        if (mem[0] != (char) (i * 3) || mem[PAGE_SIZE - 1] != (char) (i * 5))
+            fail ("rewritten data is inconsistent in page %zu", i);
+    }
+}
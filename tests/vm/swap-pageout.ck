@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-pageout) begin
+(swap-pageout) write every page
+(swap-pageout) check and rewrite every page
+(swap-pageout) check every page again
+(swap-pageout) end
+EOF
+pass;
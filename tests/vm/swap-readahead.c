@@ -0,0 +1,59 @@
+/* Reads back swapped-out pages in orders that do and do not match
+ * swap read-ahead, and rewrites them in between so that their slots
+ * are freed and reused.  A swap-in served from the swap cache must
+ * never return a slot's earlier contents.
+ * For this test, Pintos memory size is 10MB. */
+
+#include <string.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SHIFT 12
+#define PAGE_SIZE (1 << PAGE_SHIFT)
+#define ONE_MB (1 << 20) // 1MB
+#define CHUNK_SIZE (16*ONE_MB)
+#define PAGE_COUNT (CHUNK_SIZE / PAGE_SIZE)
+
+static char big_chunks[CHUNK_SIZE];
+
+/* Checks that page I holds OLD, then writes NEW into it. */
+static void
+check_and_set (size_t i, int old, int new)
+{
+    int *mem = (int *) (big_chunks + i * PAGE_SIZE);
+
+    if (*mem != old)
+        fail ("page %zu holds %d instead of %d", i, *mem, old);
+    *mem = new;
+}
+
+void
+test_main (void)
+{
+    size_t i;
+
+    msg ("write every page");
+    for (i = 0 ; i < PAGE_COUNT ; i++)
+        *(int *) (big_chunks + i * PAGE_SIZE) = (int) i;
+
+    msg ("read back in order");
+    for (i = 0 ; i < PAGE_COUNT ; i++)
+        check_and_set (i, (int) i, (int) i + PAGE_COUNT);
+
+    msg ("read back in reverse");
+    for (i = PAGE_COUNT ; i-- > 0 ; )
+        check_and_set (i, (int) i + PAGE_COUNT, (int) i + 2 * PAGE_COUNT);
+
+    msg ("read back with a stride");
+    for (i = 0 ; i < PAGE_COUNT ; i++) {
+        size_t page = i * 7 % PAGE_COUNT;
+        check_and_set (page, (int) page + 2 * PAGE_COUNT,
+                       (int) page + 3 * PAGE_COUNT);
+    }
+
+    msg ("read back in order again");
+    for (i = 0 ; i < PAGE_COUNT ; i++)
+        check_and_set (i, (int) i + 3 * PAGE_COUNT, 0);
+}
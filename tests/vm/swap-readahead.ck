@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-readahead) begin
+(swap-readahead) write every page
+(swap-readahead) read back in order
+(swap-readahead) read back in reverse
+(swap-readahead) read back with a stride
+(swap-readahead) read back in order again
+(swap-readahead) end
+EOF
+pass;
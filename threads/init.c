@@ -31,9 +31,14 @@
 #include "tests/threads/tests.h"
 #ifdef VM
 #include "vm/vm.h"
+#include "vm/zswap.h"
+#endif
+#ifdef EFILESYS
+#include "filesys/page_cache.h"
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
+#include "filesys/directory.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
@@ -216,6 +221,8 @@ parse_options (char **argv) {
 #ifdef FILESYS
 		else if (!strcmp (name, "-f"))
 			format_filesys = true;
+		else if (!strcmp (name, "-mult"))
+			disk_multiple_max = atoi (value);
 #endif
 		else if (!strcmp (name, "-rs"))
 			random_init (atoi (value));
@@ -226,6 +233,16 @@ parse_options (char **argv) {
 			user_page_limit = atoi (value);
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp (name, "-lwm"))
+			vm_low_watermark = atoi (value);
+		else if (!strcmp (name, "-hwm"))
+			vm_high_watermark = atoi (value);
+		else if (!strcmp (name, "-zswap"))
+			zswap_pages = atoi (value);
+		else if (!strcmp (name, "-swap"))
+			swap_layout = value;
 #endif
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
@@ -324,10 +341,19 @@ usage (void) {
 			"  -h                 Print this help message and power off.\n"
 			"  -q                 Power off VM after actions or on panic.\n"
 			"  -f                 Format file system disk during startup.\n"
+#ifdef FILESYS
+			"  -mult=COUNT        Move up to COUNT sectors per disk interrupt (default 16).\n"
+#endif
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -lwm=COUNT         Wake page-out daemon below COUNT free user pages.\n"
+			"  -hwm=COUNT         Page-out daemon frees up to COUNT user pages.\n"
+			"  -zswap=PAGES       Keep up to PAGES of compressed swap in memory.\n"
+			"  -swap=C:D[,C:D]... Stripe swap across the given disks (default 1:1).\n"
 #endif
 			);
 	power_off ();
@@ -356,10 +382,18 @@ print_stats (void) {
 	thread_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
+	dir_print_stats ();
 #endif
 	console_print_stats ();
 	kbd_print_stats ();
 #ifdef USERPROG
 	exception_print_stats ();
 #endif
+#ifdef VM
+	vm_print_stats ();
+	zswap_print_stats ();
+#endif
+#ifdef EFILESYS
+	page_cache_print_stats ();
+#endif
 }
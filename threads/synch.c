@@ -255,6 +255,7 @@ donate_priority (struct lock *lock) {
     old_level = intr_disable ();
     
     holder->priority = curr->priority;                 
+    thread_requeue (holder);
     list_insert_ordered(&holder->donations, &curr->d_elem, cmp_priority_donation, NULL); 
     nest_donate (curr, lock, depth_max);                           //* priority donate nestly
 
@@ -268,6 +269,7 @@ nest_donate (struct thread *curr, struct lock *lock, int depth) {
     return;
 
   lock->holder->wait_on_lock->holder->priority = curr->priority;
+  thread_requeue (lock->holder->wait_on_lock->holder);
   nest_donate (curr, lock->holder->wait_on_lock, depth - 1);
 }
 
@@ -412,3 +414,70 @@ cmp_priority_sema (struct list_elem *a, struct list_elem *b, void *aux UNUSED) {
   else
     return false;
 }
+
+/* Initializes RWLOCK, held by nobody. */
+void
+rwlock_init (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	lock_init (&rw->lock);
+	cond_init (&rw->changed);
+	rw->readers = 0;
+	rw->waiting_writers = 0;
+	rw->writer = NULL;
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or
+   waits for it. */
+void
+rwlock_acquire_read (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+
+	lock_acquire (&rw->lock);
+	while (rw->writer != NULL || rw->waiting_writers > 0)
+		cond_wait (&rw->changed, &rw->lock);
+	rw->readers++;
+	lock_release (&rw->lock);
+}
+
+/* Releases RW, held for reading by the current thread. */
+void
+rwlock_release_read (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	lock_acquire (&rw->lock);
+	ASSERT (rw->readers > 0);
+	if (--rw->readers == 0)
+		cond_broadcast (&rw->changed, &rw->lock);
+	lock_release (&rw->lock);
+}
+
+/* Acquires RW for writing, sleeping until no reader or other
+   writer holds it. */
+void
+rwlock_acquire_write (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+
+	lock_acquire (&rw->lock);
+	ASSERT (rw->writer != thread_current ());
+	rw->waiting_writers++;
+	while (rw->writer != NULL || rw->readers > 0)
+		cond_wait (&rw->changed, &rw->lock);
+	rw->waiting_writers--;
+	rw->writer = thread_current ();
+	lock_release (&rw->lock);
+}
+
+/* Releases RW, held for writing by the current thread. */
+void
+rwlock_release_write (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	lock_acquire (&rw->lock);
+	ASSERT (rw->writer == thread_current ());
+	rw->writer = NULL;
+	cond_broadcast (&rw->changed, &rw->lock);
+	lock_release (&rw->lock);
+}
@@ -1,6 +1,7 @@
 #include "threads/thread.h"
 #include <debug.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <random.h>
 #include <stdio.h>
 #include <string.h>
@@ -10,6 +11,7 @@
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -24,9 +26,23 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-static struct list ready_list;                //* 준비 완료된 스레드 리스트 : 아직 실행은 되지 않음
-static struct list sleep_list;                //* 자고있는 스레드
-static struct list all_list;                  //* 모든 스레드 리스트         < MLFQS >
+/* Run queues: one FIFO list per priority, and a bitmap with bit P set
+   while ready_queues[P] is non-empty, so that enqueueing is O(1) and
+   the highest ready priority is a single bit scan. */
+static struct list ready_queues[PRI_MAX + 1];
+static uint64_t ready_bitmap;
+static int ready_cnt;                         /* Threads in all run queues. */
+/* Sleeping threads.  A thread due within SLEEP_WHEEL_SIZE ticks is in
+   the wheel bucket of its wake-up tick, so every thread in bucket
+   T % SLEEP_WHEEL_SIZE is due at tick T.  Threads due later wait in
+   sleep_far, sorted by wake-up tick, and move into the wheel once
+   their tick comes in range.  next_sleep_event is the first tick at
+   which thread_wakeup() has anything to do; other ticks cost one
+   comparison. */
+#define SLEEP_WHEEL_SIZE 64
+static struct list sleep_wheel[SLEEP_WHEEL_SIZE];
+static struct list sleep_far;
+static int64_t next_sleep_event;
 
 static struct thread *idle_thread;            //* 대기 스레드 : ready_list에 준비된 스레드가 없을 때 호출되는 스레드
 static struct thread *initial_thread;         //* 초기화 스레드 : init.c 의 main() 함수에서 실행됨
@@ -49,6 +65,23 @@ static unsigned thread_ticks;                 //* 마지막으로 양보(yield)
 
 static int load_avg;                          //* MLFQS
 
+/* Only the running thread's recent_cpu grows between seconds, so
+   every fourth tick only its priority is recomputed.  The decay at
+   each second is applied right away to the running and ready
+   threads, whose priorities choose their run queues.  A blocked
+   thread catches up when it is unblocked, replaying the decay
+   coefficients of the seconds it missed from decay_history;
+   t->decay_epoch counts the decays already applied to T.
+
+   Blocked threads wait in decay_parked[E % DECAY_HISTORY], E being
+   their decay_epoch.  Before the history slot of second E is reused,
+   the threads in that list are caught up, so no thread ever misses
+   more seconds than the history holds. */
+#define DECAY_HISTORY 64
+static int decay_history[DECAY_HISTORY];
+static int64_t decay_epoch;
+static struct list decay_parked[DECAY_HISTORY];
+
 /*
 ! 멀티 레벨 피드백 큐 활성화 옵션
 * false(default) : round-robin 스케쥴러
@@ -66,6 +99,10 @@ static void init_thread (struct thread *, const char *name, int priority);
 static void do_schedule(int status);
 static void schedule (void);
 static tid_t allocate_tid (void);
+static int mlfqs_priority (const struct thread *);
+static void mlfqs_catch_up (struct thread *);
+static void mlfqs_park (struct thread *);
+static void mlfqs_unpark (struct thread *);
 
 #define is_thread(t) ((t) != NULL && (t)->magic == THREAD_MAGIC) //* t가 유효한 스레드를 가리키면, true를 리턴
 
@@ -103,15 +140,55 @@ void print_ready() {
     enum intr_level old_level = intr_disable ();
     struct list_elem *e;
     struct thread *t;
-
-    for (e = list_begin(&ready_list); e != list_end(&ready_list); e = e->next) {
-        t = list_entry(e, struct thread, elem);
-        printf ("thread#%d (%s) at %p, priority=%d\n", t->tid, t->name, e, t->priority);
-    }
-    printf("tail at %p\n", list_end(&ready_list));
+    int p;
+
+    for (p = PRI_MAX; p >= PRI_MIN; p--)
+      for (e = list_begin(&ready_queues[p]); e != list_end(&ready_queues[p]); e = e->next) {
+          t = list_entry(e, struct thread, elem);
+          printf ("thread#%d (%s) at %p, priority=%d\n", t->tid, t->name, e, t->priority);
+      }
+    printf("%d ready\n", ready_cnt);
     intr_set_level (old_level);
 }
 
+/* Run queue index of PRIORITY.  MLFQS may compute priorities outside
+   [PRI_MIN, PRI_MAX]; they are clamped. */
+static int
+ready_index (int priority) {
+  if (priority < PRI_MIN)
+    return PRI_MIN;
+  if (priority > PRI_MAX)
+    return PRI_MAX;
+  return priority;
+}
+
+/* Appends T to the run queue of its priority.  Interrupts must be
+   off. */
+static void
+ready_push (struct thread *t) {
+  int p = ready_index (t->priority);
+
+  list_push_back (&ready_queues[p], &t->elem);
+  ready_bitmap |= 1ULL << p;
+  t->ready_priority = p;
+  ready_cnt++;
+}
+
+/* Takes T off its run queue.  Interrupts must be off. */
+static void
+ready_remove (struct thread *t) {
+  list_remove (&t->elem);
+  if (list_empty (&ready_queues[t->ready_priority]))
+    ready_bitmap &= ~(1ULL << t->ready_priority);
+  ready_cnt--;
+}
+
+/* Highest priority with a ready thread, or -1 if none is ready. */
+static int
+ready_max (void) {
+  return ready_bitmap != 0 ? 63 - __builtin_clzll (ready_bitmap) : -1;
+}
+
 void
 thread_init (void) {
 	ASSERT (intr_get_level () == INTR_OFF);
@@ -127,10 +204,17 @@ thread_init (void) {
 
 	/* Init the globla thread context */
 	lock_init (&tid_lock);
-	list_init (&ready_list);
-  list_init (&sleep_list);
+	for (int p = PRI_MIN; p <= PRI_MAX; p++)
+		list_init (&ready_queues[p]);
+	ready_bitmap = 0;
+	ready_cnt = 0;
+  for (int i = 0; i < SLEEP_WHEEL_SIZE; i++)
+    list_init (&sleep_wheel[i]);
+  list_init (&sleep_far);
+  for (int i = 0; i < DECAY_HISTORY; i++)
+    list_init (&decay_parked[i]);
+  next_sleep_event = INT64_MAX;
 	list_init (&destruction_req);
-  list_init (&all_list);                                    //* MLFQS
   load_avg = 0;                                             //* MLFQS
 
 	/* Set up a thread structure for the running thread. */
@@ -177,6 +261,13 @@ thread_tick (void) {
 		intr_yield_on_return ();
 }
 
+/* Credits N ticks the timer skipped while only the idle thread
+   was runnable. */
+void
+thread_idle_ticks (int64_t n) {
+	idle_ticks += n;
+}
+
 /* Prints thread statistics. */
 void
 thread_print_stats (void) {
@@ -219,7 +310,6 @@ thread_create (const char *name, int priority,
   if (t != idle_thread) {                                   //* MLFQS
     t->nice = thread_current ()->nice;
     t->recent_cpu = thread_current ()->recent_cpu;
-    list_push_back(&all_list, &t->a_elem);
   }
 
 #ifdef USERPROG
@@ -260,20 +350,30 @@ void
 thread_preemption (void) {
   enum intr_level old_level;
   struct thread *curr = thread_current ();
-  struct thread *ready = list_entry (list_begin (&ready_list), struct thread, elem);
-
-  if (list_empty(&ready_list))
-    return;
 
   old_level = intr_disable ();
 
-  if (!intr_context() && curr->priority < ready->priority) {
+  if (!intr_context() && ready_index (curr->priority) < ready_max ()) {
     thread_yield ();
   }
 
   intr_set_level (old_level);
 }
 
+/* Moves T, if it is ready, to the run queue of its current priority.
+   Called after T's priority changes, e.g. by donation. */
+void
+thread_requeue (struct thread *t) {
+  enum intr_level old_level = intr_disable ();
+
+  if (t->status == THREAD_READY && t != idle_thread
+      && ready_index (t->priority) != t->ready_priority) {
+    ready_remove (t);
+    ready_push (t);
+  }
+  intr_set_level (old_level);
+}
+
 /* Puts the current thread to sleep.  It will not be scheduled
    again until awoken by thread_unblock().
 
@@ -285,6 +385,8 @@ void
 thread_block (void) {
 	ASSERT (!intr_context ());
 	ASSERT (intr_get_level () == INTR_OFF);
+  if (thread_mlfqs && thread_current () != idle_thread)
+    mlfqs_park (thread_current ());
 	thread_current ()->status = THREAD_BLOCKED;
 	schedule ();
 }
@@ -306,24 +408,59 @@ thread_unblock (struct thread *t) {
 
 	old_level = intr_disable ();
 	ASSERT (t->status == THREAD_BLOCKED);
-  if (t != idle_thread)
-    list_insert_ordered (&ready_list, &t->elem, (void *)cmp_priority, NULL);
+  if (t != idle_thread) {
+    if (thread_mlfqs)
+      mlfqs_unpark (t);
+    ready_push (t);
+  }
 	t->status = THREAD_READY;
 	intr_set_level (old_level);
 }
 
+static bool
+cmp_waken_ticks (const struct list_elem *a, const struct list_elem *b,
+    void *aux UNUSED) {
+  return list_entry (a, struct thread, elem)->waken_ticks
+    < list_entry (b, struct thread, elem)->waken_ticks;
+}
+
+/* Tick at which sleeper T needs thread_wakeup()'s attention: its
+   wake-up tick in the wheel, the tick it enters the wheel if far. */
+static int64_t
+sleep_event (const struct thread *t, bool far) {
+  return far ? t->waken_ticks - SLEEP_WHEEL_SIZE + 1 : t->waken_ticks;
+}
+
+/* Files sleeping thread T, given that the current tick is NOW.
+   Interrupts must be off. */
+static void
+sleep_insert (struct thread *t, int64_t now) {
+  bool far = t->waken_ticks - now >= SLEEP_WHEEL_SIZE;
+
+  if (far)
+    list_insert_ordered (&sleep_far, &t->elem, cmp_waken_ticks, NULL);
+  else
+    list_push_back (&sleep_wheel[t->waken_ticks % SLEEP_WHEEL_SIZE], &t->elem);
+  if (sleep_event (t, far) < next_sleep_event)
+    next_sleep_event = sleep_event (t, far);
+}
+
 //! 스레드 재우기
 void
 thread_sleep (int64_t ticks) {
   enum intr_level old_level;
   struct thread *curr = thread_current ();
-  curr->waken_ticks = ticks;
 
   ASSERT (!intr_context ());
   old_level = intr_disable();
 
+  /* Wake no earlier than the next tick, which is the first one
+     thread_wakeup() still sees. */
+  int64_t now = timer_ticks ();
+  curr->waken_ticks = ticks > now ? ticks : now + 1;
+
   if (curr != idle_thread) {
-    list_push_back(&sleep_list, &curr->elem);
+    sleep_insert (curr, now);
   }
   thread_block ();
   intr_set_level (old_level);
@@ -332,25 +469,50 @@ thread_sleep (int64_t ticks) {
 //! 스레드 깨우기
 void
 thread_wakeup(int64_t ticks) {
-  // 현재 ticks
-  // sleep_list 에는 미래의 ticks가 저장되어 있음
-  // if list_entry에서 값을 확인하고, 매 인터럽트마다 깨워야할 스레드가 있는지 확인해야함
-  struct list_elem *e = list_begin (&sleep_list);
-
-  while (e != list_end (&sleep_list)) {
-    struct thread *chk_t = list_entry (e, struct thread, elem);
-    int64_t woke_ticks = chk_t->waken_ticks;
-
-    if (woke_ticks <= ticks) {
-      e = list_remove (e);
-      thread_unblock (chk_t);
-    }
-    else {
-      e = list_next(e);
+  struct list *bucket = &sleep_wheel[ticks % SLEEP_WHEEL_SIZE];
+  int i;
+
+  if (ticks < next_sleep_event)
+    return;
+
+  /* Bring far sleepers that are now in range into the wheel. */
+  while (!list_empty (&sleep_far)) {
+    struct thread *t = list_entry (list_front (&sleep_far), struct thread, elem);
+    if (t->waken_ticks - ticks >= SLEEP_WHEEL_SIZE)
+      break;
+    list_pop_front (&sleep_far);
+    list_push_back (&sleep_wheel[t->waken_ticks % SLEEP_WHEEL_SIZE], &t->elem);
+  }
+
+  /* Everyone in this tick's bucket is due. */
+  while (!list_empty (bucket)) {
+    struct thread *t = list_entry (list_pop_front (bucket), struct thread, elem);
+    ASSERT (t->waken_ticks == ticks);
+    thread_unblock (t);
+  }
+
+  /* Find the next event: the nearest non-empty bucket, or the first
+     far sleeper entering the wheel. */
+  next_sleep_event = INT64_MAX;
+  for (i = 1; i < SLEEP_WHEEL_SIZE; i++)
+    if (!list_empty (&sleep_wheel[(ticks + i) % SLEEP_WHEEL_SIZE])) {
+      next_sleep_event = ticks + i;
+      break;
     }
+  if (!list_empty (&sleep_far)) {
+    struct thread *t = list_entry (list_front (&sleep_far), struct thread, elem);
+    if (sleep_event (t, true) < next_sleep_event)
+      next_sleep_event = sleep_event (t, true);
   }
 }
 
+/* Returns the first tick at which a sleeper is due, or INT64_MAX
+   if nobody sleeps. */
+int64_t
+thread_next_wakeup (void) {
+  return next_sleep_event;
+}
+
 /* Returns the name of the running thread. */
 const char *
 thread_name (void) {
@@ -394,13 +556,6 @@ thread_exit (void) {
 	/* Just set our status to dying and schedule another process.
 	   We will be destroyed during the call to schedule_tail(). */
 	intr_disable ();
-	struct list_elem *e = list_head (&all_list);
-  while ((e = list_next (e)) != list_end (&all_list)) {
-    struct thread *t = list_entry (e, struct thread, a_elem);
-
-    if (thread_current () == t)
-      list_remove(&t->a_elem);
-  }
 	do_schedule (THREAD_DYING);
 	NOT_REACHED ();
 }
@@ -417,7 +572,7 @@ thread_yield (void) {
 
 	old_level = intr_disable ();
 	if (curr != idle_thread)
-    list_insert_ordered (&ready_list, &curr->elem, (void *)cmp_priority, NULL);
+    ready_push (curr);
 
 	do_schedule (THREAD_READY);
 	intr_set_level (old_level);
@@ -481,7 +636,7 @@ thread_set_nice (int new_nice UNUSED) {
   struct thread *curr = thread_current ();
 
   curr->nice = new_nice;   
-  curr->priority = ((PRI_MAX * F) - (curr->recent_cpu / 4) - (curr->nice * 2 * F))>>14;
+  curr->priority = mlfqs_priority (curr);
 
   thread_preemption ();                                                 
 }
@@ -516,33 +671,108 @@ thread_get_recent_cpu (void) {
 //! 전역변수 load_avg를 갱신해주는 함수
 void 
 thread_calc_load_avg (void) {
-  int ready_threads = thread_current () == idle_thread 
-  ? (int)list_size (&ready_list) 
-  : (int)list_size (&ready_list) + 1;
+  int ready_threads = running_thread () == idle_thread 
+  ? ready_cnt 
+  : ready_cnt + 1;
 
   load_avg = (((int64_t)(59*F)/60) * load_avg)/F + ((F/60) * ready_threads);
 }
 
-//! 모든 스레드의 recent_cpu를 갱신해주는 함수
+/* MLFQS priority of T for its current recent_cpu and nice. */
+static int
+mlfqs_priority (const struct thread *t) {
+  return ((PRI_MAX * F) - (t->recent_cpu / 4) - (t->nice * 2 * F))>>14;
+}
+
+/* Applies one second of decay with coefficient COEF to T. */
+static void
+decay_recent_cpu (struct thread *t, int coef) {
+  t->recent_cpu = (int64_t)t->recent_cpu * coef / F + (t->nice * F);
+}
+
+/* Brings blocked thread T's recent_cpu and priority up to date. */
+static void
+mlfqs_catch_up (struct thread *t) {
+  int64_t e;
+
+  if (t->decay_epoch == decay_epoch)
+    return;
+
+  ASSERT (decay_epoch - t->decay_epoch <= DECAY_HISTORY);
+  for (e = t->decay_epoch; e < decay_epoch; e++)
+    decay_recent_cpu (t, decay_history[e % DECAY_HISTORY]);
+
+  t->decay_epoch = decay_epoch;
+  t->priority = mlfqs_priority (t);
+}
+
+/* Files T, which is about to block, under its decay_epoch. */
+static void
+mlfqs_park (struct thread *t) {
+  list_push_back (&decay_parked[t->decay_epoch % DECAY_HISTORY],
+                  &t->decay_elem);
+  t->decay_parked = true;
+}
+
+/* Takes T, which is being unblocked, off its decay_parked list and
+   catches it up. */
+static void
+mlfqs_unpark (struct thread *t) {
+  if (t->decay_parked) {
+    list_remove (&t->decay_elem);
+    t->decay_parked = false;
+  }
+  mlfqs_catch_up (t);
+}
+
+//! 실행 중인 스레드와 준비된 스레드의 recent_cpu를 갱신해주는 함수
 void
 thread_calc_recent_cpu (void) {
-  struct list_elem *e = list_head (&all_list);
+  struct thread *curr = running_thread ();
+  int coef = (int64_t)(2 * load_avg) * F / (2 * load_avg + F);
+  struct list *parked = &decay_parked[decay_epoch % DECAY_HISTORY];
+  struct list_elem *e;
+  struct list ready;
+  int p;
+
+  /* Threads blocked since DECAY_HISTORY seconds ago still need the
+     slot about to be overwritten.  Caught up, they belong to the
+     current second, whose list is the same one. */
+  for (e = list_begin (parked); e != list_end (parked); e = list_next (e))
+    mlfqs_catch_up (list_entry (e, struct thread, decay_elem));
+
+  decay_history[decay_epoch++ % DECAY_HISTORY] = coef;
 
-  while ((e = list_next (e)) != list_end (&all_list)) {
-    struct thread *t = list_entry (e, struct thread, a_elem);
-    t->recent_cpu = (int64_t)t->recent_cpu * (2 * load_avg) / (2 * load_avg + F) + (t->nice * F);
+  if (curr != idle_thread) {
+    decay_recent_cpu (curr, coef);
+    curr->decay_epoch = decay_epoch;
+  }
+
+  /* Ready threads change priority, so empty the run queues and
+     refill them in their current order. */
+  list_init (&ready);
+  for (p = PRI_MAX; p >= PRI_MIN; p--)
+    while (!list_empty (&ready_queues[p]))
+      list_push_back (&ready, list_pop_front (&ready_queues[p]));
+  ready_bitmap = 0;
+  ready_cnt = 0;
+
+  while (!list_empty (&ready)) {
+    struct thread *t = list_entry (list_pop_front (&ready), struct thread, elem);
+    decay_recent_cpu (t, coef);
+    t->decay_epoch = decay_epoch;
+    t->priority = mlfqs_priority (t);
+    ready_push (t);
   }
 }
 
-//! 모든 스레드의 priority를 갱신해주는 함수
+//! 실행 중인 스레드의 priority를 갱신해주는 함수 (다른 스레드의 recent_cpu는 그대로)
 void
 thread_calc_priority (void) {
-  struct list_elem *e = list_head (&all_list);
+  struct thread *curr = running_thread ();
 
-  while ((e = list_next (e)) != list_end (&all_list)) {
-    struct thread *t = list_entry (e, struct thread, a_elem);
-    t->priority = ((PRI_MAX * F) - (t->recent_cpu / 4) - (t->nice * 2 * F))>>14;
-  }
+  if (curr != idle_thread)
+    curr->priority = mlfqs_priority (curr);
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -559,7 +789,6 @@ idle (void *idle_started_ UNUSED) {
 	struct semaphore *idle_started = idle_started_;
 
 	idle_thread = thread_current ();
-  list_remove (&idle_thread->a_elem);                       //* MLFQS
 	sema_up (idle_started);
 
 	for (;;) {
@@ -567,6 +796,10 @@ idle (void *idle_started_ UNUSED) {
 		intr_disable ();
 		thread_block ();
 
+		/* Nothing else is runnable: let the timer skip the ticks
+		   until the next sleeper is due. */
+		timer_idle_enter ();
+
 		/* Re-enable interrupts and wait for the next one.
 
 		   The `sti' instruction disables interrupts until the
@@ -612,6 +845,7 @@ init_thread (struct thread *t, const char *name, int priority) {
   list_init (&t->donations);
   t->recent_cpu = 0;                                        //* MLFQS
   t->nice = 0;                                              //* MLFQS
+  t->decay_epoch = decay_epoch;                             //* MLFQS
 
 #ifdef USERPROG
   list_init (&t->child_list);
@@ -622,16 +856,22 @@ init_thread (struct thread *t, const char *name, int priority) {
 }
 
 /* Chooses and returns the next thread to be scheduled.  Should
-   return a thread from the run queue, unless the run queue is
-   empty.  (If the running thread can continue running, then it
+   return a thread from the highest non-empty run queue, unless
+   all are empty.  (If the running thread can continue running, then it
    will be in the run queue.)  If the run queue is empty, return
    idle_thread. */
 static struct thread *
 next_thread_to_run (void) {
-	if (list_empty (&ready_list))
+	int p = ready_max ();
+
+	if (p < 0)
 		return idle_thread;
-	else
-		return list_entry (list_pop_front (&ready_list), struct thread, elem);
+	else {
+		struct thread *t = list_entry (list_front (&ready_queues[p]),
+				struct thread, elem);
+		ready_remove (t);
+		return t;
+	}
 }
 
 /* Use iretq to launch the thread */
@@ -753,11 +993,21 @@ do_schedule(int status) {
 static void
 schedule (void) {
 	struct thread *curr = running_thread ();
-	struct thread *next = next_thread_to_run ();
+	struct thread *next;
 
 	ASSERT (intr_get_level () == INTR_OFF);
 	ASSERT (curr->status != THREAD_RUNNING);
+
+	/* Leaving idle: bring the clock up to date and restore the
+	   normal timer rate before choosing, so that the sleepers due
+	   meanwhile and the MLFQS updates of the skipped seconds are
+	   in place when the next thread is picked. */
+	if (curr == idle_thread)
+		timer_idle_exit ();
+
+	next = next_thread_to_run ();
 	ASSERT (is_thread (next));
+
 	/* Mark us as running. */
 	next->status = THREAD_RUNNING;
 
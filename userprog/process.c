@@ -87,9 +87,6 @@ initd (void *f_name) {
 
 	process_init ();
 
-  /* --- Project 3 - VM --- */
-  lock_init (&filesys_lock);
-
 	if (process_exec (f_name) < 0)
 		PANIC("Fail to launch initd\n");
 	NOT_REACHED ();
@@ -470,9 +467,7 @@ load (const char *file_name, struct intr_frame *if_) {
 	process_activate (thread_current ());
 
 	/* Open executable file. */
-  lock_acquire(&filesys_lock);
 	file = filesys_open (file_name);
-  lock_release(&filesys_lock);
 
 	if (file == NULL) {
 		printf ("load: %s: open failed\n", file_name);
@@ -758,8 +753,9 @@ lazy_load_segment (struct page *page, void *aux) {
     memcpy (page->anon.aux, f_info, sizeof (file_info));
   }
 
-  file_seek(f_info->file, f_info->ofs);
-  if (file_read (f_info->file, read_addr, f_info->read_bytes) != (int)f_info->read_bytes) {
+  /* The file may be shared with other processes, so its position is
+   * left alone. */
+  if (file_read_at (f_info->file, read_addr, f_info->read_bytes, f_info->ofs) != (int)f_info->read_bytes) {
     palloc_free_page (pg_round_down (page));
     return false;
   }
@@ -789,28 +785,17 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (ofs % PGSIZE == 0);
 
-	while (read_bytes > 0 || zero_bytes > 0) {
-		/* Do calculate how to fill this page.
-		 * We will read PAGE_READ_BYTES bytes from FILE
-		 * and zero the final PAGE_ZERO_BYTES bytes. */
-		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-		size_t page_zero_bytes = PGSIZE - page_read_bytes;
-    file_info *f_info;
+  /* Record the segment as one area, its pages are made on first access
+   * from the area's own handle on FILE. */
+  struct file *seg_file = file_reopen (file);
 
-    if (!(f_info = malloc (sizeof(file_info)))) {
-      return false;
-    }
-    f_info->file = file;
-    f_info->read_bytes = page_read_bytes;
-    f_info->ofs = ofs;
-    if (!vm_alloc_page_with_initializer (VM_ANON, upage, writable, lazy_load_segment, f_info)) {
-      return false;
-    }
-		/* Advance. */
-		read_bytes -= page_read_bytes;
-		zero_bytes -= page_zero_bytes;
-		upage += PGSIZE;
-    ofs += page_read_bytes;
+  if (seg_file == NULL) {
+    return false;
+  }
+  if (!vma_create (&thread_current ()->spt.vmas, upage, read_bytes + zero_bytes,
+        VM_ANON, writable, seg_file, ofs, read_bytes)) {
+    file_close (seg_file);
+    return false;
   }
 	return true;
 }
@@ -138,7 +138,7 @@ static void
 check_addr (const char *file) {
   void *addr = (void *)file;
 #ifdef VM
-  struct page *find_page = spt_find_page (&thread_current ()->spt, addr);
+  struct page *find_page = vm_get_page (thread_current (), addr);
   if (!addr || !is_user_vaddr (addr) || !find_page) {
     exit (-1);
   }
@@ -153,7 +153,7 @@ static void
 check_with_writable (const char *file) {
   void *addr = (void *)file;
 #ifdef VM
-  struct page *find_page = spt_find_page (&thread_current ()->spt, addr);
+  struct page *find_page = vm_get_page (thread_current (), addr);
   if (!addr || !is_user_vaddr (addr) || !find_page) {
     exit (-1);
   }
@@ -219,9 +219,7 @@ static bool
 create (const char* file, unsigned initial_size) {
   check_addr(file);
 
-  lock_acquire(&filesys_lock);
   bool succ = filesys_create(file, initial_size);
-  lock_release(&filesys_lock);
 
   return succ;
 }
@@ -230,9 +228,7 @@ static int
 open (const char *file) {
   check_addr(file);
 
-  lock_acquire(&filesys_lock);
   struct file *f = filesys_open(file);
-  lock_release (&filesys_lock);
 
   if (f == NULL) {
     return -1;
@@ -257,9 +253,7 @@ static bool
 remove (const char *file) {
   check_addr(file);
 
-  lock_acquire(&filesys_lock);
   bool succ = filesys_remove(file);
-  lock_release(&filesys_lock);
 
   return succ;
 }
@@ -293,9 +287,7 @@ read (int fd, void *buffer, unsigned length) {
     return -1;
   }
 
-  lock_acquire (&filesys_lock);
   int read_size = file_read(f, buffer, length);
-  lock_release (&filesys_lock);
 
   return read_size;
 }
@@ -317,9 +309,7 @@ write (int fd, const void *buffer, unsigned length) {
     if (f == NULL)
       return -1;
 
-    lock_acquire (&filesys_lock);
     int write_size = file_write(f, buffer, length);
-    lock_release (&filesys_lock);
 
     return write_size;
   }
@@ -360,9 +350,7 @@ close (int fd) {
 
   curr->fd_table[fd] = NULL;
 
-  lock_acquire (&filesys_lock);
   file_close(f);
-  lock_release (&filesys_lock);
 }
 
 void *
@@ -385,7 +373,13 @@ mmap (void *addr, size_t length, int writable, int fd, off_t offset) {
   }
 
   struct file *n_f = file_reopen (file);
+  if (n_f == NULL) {
+    return NULL;
+  }
   succ = do_mmap (addr, length, writable, n_f, offset);
+  if (succ == NULL) {
+    file_close (n_f);
+  }
   return succ;
 }
 
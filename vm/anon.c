@@ -4,11 +4,15 @@
 #include "devices/disk.h"
 /* ------ Project 3 ------ */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "kernel/bitmap.h"
 #include "threads/malloc.h"
 #include "threads/init.h"
 #include "threads/vaddr.h"
 #include "threads/mmu.h"
+#include "threads/synch.h"
+#include "vm/zswap.h"
 
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
@@ -18,9 +22,68 @@ static void anon_destroy (struct page *page);
 
 /* ------ Project 3 ------ */
 static struct bitmap *swap_bitmap;
+static struct lock swap_lock;      /* Protects swap_bitmap and swap_cursor. */
+static size_t swap_cursor;         /* Next slot to try, for next-fit allocation. */
 
 #define SWAP_SEGMENT (PGSIZE / DISK_SECTOR_SIZE)
 
+/* ------ Project 3 : Swap Striping ------ */
+/* Swap may span several disks, given as "CHAN:DEV,..." by -swap.
+ * Slots are striped across them one page at a time, RAID-0 style: slot
+ * S lives at slot S / swap_disk_cnt of disk S % swap_disk_cnt.  The
+ * pages of a multi-slot transfer are submitted to their disks at once,
+ * so disks on different channels work in parallel. */
+#define SWAP_DISK_MAX 4
+#define SWAP_IO_MAX 8
+
+const char *swap_layout;           /* -swap option, NULL for the default. */
+static struct disk *swap_disks[SWAP_DISK_MAX];
+static size_t swap_disk_cnt;
+
+static size_t swap_slot_alloc (size_t hint);
+static void swap_slot_free (size_t slot);
+
+/* ------ Project 3 : Swap Cache ------ */
+/* A disk swap-in also reads up to SWAP_RA_MAX slots that follow it, as
+ * long as they are in use, into a small ring of cached pages.  Since a
+ * process swaps out into consecutive slots where it can (see
+ * swap_slot_alloc), those are likely its next faults, which are then
+ * served by a copy.
+ *
+ * swap_cache_lock protects the ring only and is never held over disk
+ * I/O.  Read-ahead marks its entries READING while their transfer is
+ * in flight, and a swap-in of such a slot waits on the entry.  Once a
+ * swap-out has written a slot it drops any copy of the slot, even one
+ * still being read, so a copy read ahead of a slot's latest contents
+ * never survives. */
+#define SWAP_CACHE_PAGES 16
+#define SWAP_RA_MAX 4
+
+struct swap_cache_entry {
+  size_t slot;             /* Cached slot, SIZE_MAX if empty. */
+  bool reading;            /* Read ahead in flight. */
+  struct condition read_done;  /* Signaled when READING clears. */
+};
+
+static struct swap_cache_entry swap_cache[SWAP_CACHE_PAGES];
+static uint8_t *swap_cache_pages;  /* SWAP_CACHE_PAGES contiguous pages. */
+static size_t swap_cache_pos;      /* Next ring entry to fill. */
+static struct lock swap_cache_lock;
+
+static long long swap_cache_hit_cnt;   /* # of swap-ins served by the cache. */
+static long long swap_ra_cnt;          /* # of slots read ahead. */
+
+/* ------ Project 3 : Zswap Writeback ------ */
+/* When the zswap arena is full, a swap-out first moves up to
+ * ZSWAP_WRITEBACK_MAX of its oldest pages on to the disk, through a
+ * bounce page, to make room for the one being evicted.  One writeback
+ * runs at a time; an evictor that finds one in progress sends its own
+ * page to the disk instead of waiting. */
+#define ZSWAP_WRITEBACK_MAX 4
+
+static void *zswap_wb_page;        /* Bounce page, under zswap_wb_lock. */
+static struct lock zswap_wb_lock;
+
 /* DO NOT MODIFY this struct */
 static const struct page_operations anon_ops = {
 	.swap_in = anon_swap_in,
@@ -43,11 +106,255 @@ static void page_dump (struct page *page, int bytes) {
   printf ("\n[DBG] dump done\n");
 }
 
+/* Parses swap_layout into swap_disks.  The default is hd1:1 alone. */
+static void
+swap_layout_parse (void) {
+  char layout[32];
+  char *token, *save_ptr;
+
+  strlcpy (layout, swap_layout != NULL ? swap_layout : "1:1", sizeof layout);
+  swap_disk_cnt = 0;
+  for (token = strtok_r (layout, ",", &save_ptr); token != NULL;
+      token = strtok_r (NULL, ",", &save_ptr)) {
+    char *dev = strchr (token, ':');
+    if (dev == NULL || swap_disk_cnt == SWAP_DISK_MAX) {
+      PANIC ("bad swap layout `%s'", swap_layout);
+    }
+    struct disk *d = disk_get (atoi (token), atoi (dev + 1));
+    if (d == NULL) {
+      PANIC ("swap disk %s not present", token);
+    }
+    swap_disks[swap_disk_cnt++] = d;
+  }
+  if (swap_disk_cnt == 0) {
+    PANIC ("bad swap layout `%s'", swap_layout);
+  }
+}
+
 /* Initialize the data for anonymous pages */
 void
 vm_anon_init (void) {
-  swap_disk = disk_get (1, 1);
-  swap_bitmap = bitmap_create (disk_size (swap_disk) / SWAP_SEGMENT);
+  swap_layout_parse ();
+  swap_disk = swap_disks[0];
+
+  /* A stripe is as long as the smallest disk allows. */
+  size_t slots_per_disk = SIZE_MAX;
+  for (size_t i = 0; i < swap_disk_cnt; i++) {
+    size_t slots = disk_size (swap_disks[i]) / SWAP_SEGMENT;
+    if (slots < slots_per_disk) {
+      slots_per_disk = slots;
+    }
+  }
+  swap_bitmap = bitmap_create (slots_per_disk * swap_disk_cnt);
+  lock_init (&swap_lock);
+  swap_cursor = 0;
+  zswap_init ();
+  lock_init (&zswap_wb_lock);
+  zswap_wb_page = zswap_pages > 0 ? palloc_get_page (0) : NULL;
+
+  lock_init (&swap_cache_lock);
+  swap_cache_pages = palloc_get_multiple (0, SWAP_CACHE_PAGES);
+  for (size_t i = 0; i < SWAP_CACHE_PAGES; i++) {
+    swap_cache[i].slot = SIZE_MAX;
+    swap_cache[i].reading = false;
+    cond_init (&swap_cache[i].read_done);
+  }
+  swap_cache_pos = 0;
+}
+
+/* Allocate a free swap slot, HINT if it is free.  Otherwise the search
+ * starts where the previous one stopped and wraps around once, so the
+ * cost does not grow with the number of slots already in use at the
+ * front of the partition. */
+static size_t
+swap_slot_alloc (size_t hint) {
+  lock_acquire (&swap_lock);
+  if (hint < bitmap_size (swap_bitmap) && !bitmap_test (swap_bitmap, hint)) {
+    bitmap_mark (swap_bitmap, hint);
+    lock_release (&swap_lock);
+    return hint;
+  }
+
+  size_t slot = bitmap_scan_and_flip (swap_bitmap, swap_cursor, 1, false);
+  if (slot == BITMAP_ERROR && swap_cursor != 0) {
+    slot = bitmap_scan_and_flip (swap_bitmap, 0, 1, false);
+  }
+  if (slot != BITMAP_ERROR) {
+    swap_cursor = slot + 1 < bitmap_size (swap_bitmap) ? slot + 1 : 0;
+  }
+  lock_release (&swap_lock);
+  return slot;
+}
+
+static void
+swap_slot_free (size_t slot) {
+  lock_acquire (&swap_lock);
+  bitmap_set (swap_bitmap, slot, false);
+  lock_release (&swap_lock);
+}
+
+static void
+swap_io_complete (struct disk_request *r) {
+  sema_up (r->aux);
+}
+
+/* Reads or writes the CNT pages at BUFFER from or to the CNT slots
+ * starting at SLOT.  Pages that are consecutive on one disk and in
+ * memory share a request; all requests are in flight together. */
+static void
+swap_io (size_t slot, void *buffer, size_t cnt, bool write) {
+  struct disk_request reqs[SWAP_IO_MAX];
+  struct semaphore done;
+  size_t req_cnt = 0;
+
+  ASSERT (cnt <= SWAP_IO_MAX);
+
+  sema_init (&done, 0);
+  for (size_t i = 0; i < cnt; i++) {
+    struct disk *d = swap_disks[(slot + i) % swap_disk_cnt];
+    disk_sector_t sector = (slot + i) / swap_disk_cnt * SWAP_SEGMENT;
+    uint8_t *page = (uint8_t *) buffer + i * PGSIZE;
+    struct disk_request *prev = req_cnt > 0 ? &reqs[req_cnt - 1] : NULL;
+
+    if (prev != NULL && prev->disk == d && prev->sector + prev->cnt == sector
+        && (uint8_t *) prev->buffer + prev->cnt * DISK_SECTOR_SIZE == page) {
+      prev->cnt += SWAP_SEGMENT;
+      continue;
+    }
+    reqs[req_cnt++] = (struct disk_request) {
+      .disk = d,
+      .sector = sector,
+      .cnt = SWAP_SEGMENT,
+      .buffer = page,
+      .write = write,
+      .complete = swap_io_complete,
+      .aux = &done,
+    };
+  }
+
+  for (size_t i = 0; i < req_cnt; i++) {
+    disk_submit (&reqs[i]);
+  }
+  for (size_t i = 0; i < req_cnt; i++) {
+    sema_down (&done);
+  }
+}
+
+/* Returns the ring entry caching SLOT, or NULL.  The caller must hold
+ * swap_cache_lock. */
+static struct swap_cache_entry *
+swap_cache_find (size_t slot) {
+  for (size_t i = 0; i < SWAP_CACHE_PAGES; i++) {
+    if (swap_cache[i].slot == slot) {
+      return &swap_cache[i];
+    }
+  }
+  return NULL;
+}
+
+static void *
+swap_cache_page (struct swap_cache_entry *e) {
+  return swap_cache_pages + (e - swap_cache) * PGSIZE;
+}
+
+/* Read the in-use slots that directly follow SLOT into the ring, all
+ * in flight at once. */
+static void
+swap_read_ahead (size_t slot) {
+  struct swap_cache_entry *e;
+  size_t n = 0;
+
+  if (swap_cache_pages == NULL) {
+    return;
+  }
+  lock_acquire (&swap_cache_lock);
+  lock_acquire (&swap_lock);
+  while (n < SWAP_RA_MAX && slot + n + 1 < bitmap_size (swap_bitmap)
+      && bitmap_test (swap_bitmap, slot + n + 1)
+      && swap_cache_find (slot + n + 1) == NULL) {
+    n++;
+  }
+  lock_release (&swap_lock);
+
+  /* The batch takes N consecutive ring entries, up to the first one
+   * still being filled by an earlier batch. */
+  if (swap_cache_pos + n > SWAP_CACHE_PAGES) {
+    swap_cache_pos = 0;
+  }
+  e = &swap_cache[swap_cache_pos];
+  for (size_t i = 0; i < n; i++) {
+    if (e[i].reading) {
+      n = i;
+      break;
+    }
+  }
+  if (n == 0) {
+    lock_release (&swap_cache_lock);
+    return;
+  }
+  for (size_t i = 0; i < n; i++) {
+    e[i].slot = slot + 1 + i;
+    e[i].reading = true;
+  }
+  swap_cache_pos = (swap_cache_pos + n) % SWAP_CACHE_PAGES;
+  lock_release (&swap_cache_lock);
+
+  swap_io (slot + 1, swap_cache_page (e), n, false);
+
+  lock_acquire (&swap_cache_lock);
+  for (size_t i = 0; i < n; i++) {
+    e[i].reading = false;
+    cond_broadcast (&e[i].read_done, &swap_cache_lock);
+  }
+  swap_ra_cnt += n;
+  lock_release (&swap_cache_lock);
+}
+
+/* Prints swap cache statistics. */
+void
+swap_print_stats (void) {
+  printf ("Swap: %lld slots read ahead, %lld swap-ins from the swap cache\n",
+      swap_ra_cnt, swap_cache_hit_cnt);
+}
+
+/* Writes the page at KVA to a free slot, HINT if it is free, and
+ * returns the slot. */
+static size_t
+swap_write (const void *kva, size_t hint) {
+  size_t slot = swap_slot_alloc (hint);
+  if (slot == BITMAP_ERROR) {
+    PANIC (" ANON_SWAP_ERROR : NOT FOUND BITMAP\n");
+  }
+
+  swap_io (slot, (void *) kva, 1, true);
+
+  /* Drop a copy of the slot's earlier contents, or one read ahead
+   * while this write was in flight. */
+  lock_acquire (&swap_cache_lock);
+  struct swap_cache_entry *e = swap_cache_find (slot);
+  if (e) {
+    e->slot = SIZE_MAX;
+  }
+  lock_release (&swap_cache_lock);
+  return slot;
+}
+
+/* Moves the oldest page of the zswap arena to the disk.  Returns false
+ * if nothing was moved, because the arena is empty or another thread
+ * is already writing back. */
+static bool
+zswap_writeback (void) {
+  struct zswap_entry *entry;
+
+  if (zswap_wb_page == NULL || !lock_try_acquire (&zswap_wb_lock)) {
+    return false;
+  }
+  entry = zswap_writeback_begin (zswap_wb_page);
+  if (entry != NULL) {
+    zswap_writeback_end (entry, swap_write (zswap_wb_page, SIZE_MAX));
+  }
+  lock_release (&zswap_wb_lock);
+  return entry != NULL;
 }
 
 /* Initialize the file mapping */
@@ -57,6 +364,7 @@ anon_initializer (struct page *page, enum vm_type type, void *kva) {
 	page->operations = &anon_ops;
 
 	struct anon_page *anon_page = &page->anon;
+  anon_page->swap_idx = SWAP_IDX_NONE;
   return true;
 }
 
@@ -66,13 +374,35 @@ anon_swap_in (struct page *page, void *kva) {
 	struct anon_page *anon_page = &page->anon;
 
   void *addr = pg_round_down (page->frame->kva);
-  for (int i = 0; i < SWAP_SEGMENT; i++) {
-    disk_read (swap_disk, (anon_page->swap_idx * SWAP_SEGMENT) + i, addr + (DISK_SECTOR_SIZE * i));
+  size_t slot = anon_page->swap_idx;
+
+  /* A zswap page may have been written back to the disk meanwhile. */
+  if (anon_page->swap_idx == SWAP_IDX_ZSWAP) {
+    slot = zswap_load (&anon_page->zswap, addr);
   }
-  page->va = (void *)((uint64_t)page->va | PTE_P);
+  if (slot != ZSWAP_NO_SLOT) {
+    struct swap_cache_entry *e;
 
-  bitmap_set (swap_bitmap, anon_page->swap_idx, false);
-  anon_page->swap_idx = -1;
+    lock_acquire (&swap_cache_lock);
+    while ((e = swap_cache_find (slot)) != NULL && e->reading) {
+      cond_wait (&e->read_done, &swap_cache_lock);
+    }
+    if (e) {
+      memcpy (addr, swap_cache_page (e), PGSIZE);
+      e->slot = SIZE_MAX;
+      swap_cache_hit_cnt++;
+    }
+    lock_release (&swap_cache_lock);
+
+    if (e == NULL) {
+      swap_io (slot, addr, 1, false);
+      swap_read_ahead (slot);
+      zswap_note_disk_read ();
+    }
+    swap_slot_free (slot);
+  }
+  page->va = (void *)((uint64_t)page->va | PTE_P);
+  anon_page->swap_idx = SWAP_IDX_NONE;
 
   return true;
 }
@@ -81,19 +411,29 @@ anon_swap_in (struct page *page, void *kva) {
 static bool
 anon_swap_out (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+  void *addr = pg_round_down (page->frame->kva);
 
-  int bit_idx = bitmap_scan_and_flip (swap_bitmap, 0, 1, false);
-  if (bit_idx == BITMAP_ERROR) {
-    PANIC (" ANON_SWAP_ERROR : NOT FOUND BITMAP\n");
-  }
+  /* Unmap first.  A store by the owner now faults and waits for the
+   * eviction to finish, instead of landing in a frame that has already
+   * been copied out. */
+  pml4_clear_page (page->owner->pml4, pg_round_down (page->va));
 
-  void *addr = pg_round_down (page->frame->kva);
-  for (int i = 0; i < SWAP_SEGMENT; i++) {
-    disk_write (swap_disk, (bit_idx * SWAP_SEGMENT) + i, addr + (DISK_SECTOR_SIZE * i));
+  /* The compressed tier first, the disk when it declines. */
+  enum zswap_result r = zswap_store (addr, &anon_page->zswap);
+  for (int i = 0; r == ZSWAP_FULL && i < ZSWAP_WRITEBACK_MAX
+      && zswap_writeback (); i++) {
+    r = zswap_store (addr, &anon_page->zswap);
+  }
+  if (r == ZSWAP_STORED) {
+    anon_page->swap_idx = SWAP_IDX_ZSWAP;
+  }
+  else {
+    /* Keep the pages of one process in consecutive slots. */
+    struct supplemental_page_table *spt = &page->owner->spt;
+    size_t bit_idx = swap_write (addr, spt->swap_next);
+    spt->swap_next = bit_idx + 1;
+    anon_page->swap_idx = bit_idx;
   }
-
-  pml4_clear_page (thread_current ()->pml4, pg_round_down (page->va));
-  anon_page->swap_idx = bit_idx;
 
   page->va = (void *)((uint64_t)page->va & ~PTE_P);
   return true;
@@ -107,8 +447,18 @@ anon_destroy (struct page *page) {
     free (anon_page->aux);
   }
 
-  if (page->frame) {
-    list_remove (&page->frame->f_elem);
-    free (page->frame);
+  /* vm_free_frame waits for an eviction of the page in progress, so
+   * afterwards swap_idx tells whether the page is swapped out, possibly
+   * by pageoutd just now.  Such a page gives back its slot. */
+  vm_free_frame (page);
+
+  if (anon_page->swap_idx == SWAP_IDX_ZSWAP) {
+    size_t slot = zswap_free (&anon_page->zswap);
+    if (slot != ZSWAP_NO_SLOT) {
+      swap_slot_free (slot);
+    }
+  }
+  else if (anon_page->swap_idx != SWAP_IDX_NONE) {
+    swap_slot_free (anon_page->swap_idx);
   }
 }
\ No newline at end of file
@@ -56,16 +56,19 @@ static bool
 file_backed_swap_out (struct page *page) {
   struct file_page *file_page = &page->file;
 
+  /* Unmap first, so that a store by the owner during the write-back
+   * faults and waits for it.  The dirty bit stays in the cleared PTE. */
+  pml4_clear_page (page->owner->pml4, pg_round_down (page->va));
+
   if (file_page->aux) {
     file_info *f_info = page->file.aux;
 
-    if (pml4_is_dirty (thread_current ()->pml4, page->va) || pml4_is_dirty (base_pml4, page->frame->kva)) {
+    if (pml4_is_dirty (page->owner->pml4, page->va) || pml4_is_dirty (base_pml4, page->frame->kva)) {
       file_write_at (f_info->file, page->frame->kva, f_info->read_bytes, f_info->ofs);
     }
   }
 
-  pml4_set_dirty (thread_current ()->pml4, page->va, 0);
-  pml4_clear_page (thread_current ()->pml4, pg_round_down (page->va));
+  pml4_set_dirty (page->owner->pml4, page->va, 0);
 
   page->va = (void *)((uint64_t)page->va & ~PTE_P);
   return true;
@@ -85,61 +88,75 @@ file_backed_destroy (struct page *page) {
     free (file_page->aux);
   }
 
-  if (page->frame) {
-    list_remove (&page->frame->f_elem);
-    free (page->frame);
-  }
+  vm_free_frame (page);
 
   pml4_clear_page (thread_current ()->pml4, pg_round_down (page->va));
 }
 
-/* Do the mmap */
-void *
-do_mmap (void *addr, size_t length, int writable, struct file *file, off_t offset) {
-  void *init_addr = addr;
-  uint32_t init_length = length;
-  uint32_t read_bytes = file_length (file);
-
-  while ((int)length > 0) {
-
-    size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-    file_info *f_info;
-    if (!(f_info = malloc (sizeof (file_info)))) {
-      return NULL;
+/* Whether SPT already has a page in [START, END).  Walks whichever is
+ * smaller, the range or the table. */
+static bool
+mmap_range_used (struct supplemental_page_table *spt, void *start, void *end) {
+  size_t range_cnt = ((uint8_t *)end - (uint8_t *)start) / PGSIZE;
+
+  if (range_cnt <= hash_size (&spt->spt_hash)) {
+    for (void *va = start; va < end; va += PGSIZE) {
+      if (page_lookup (va, spt)) {
+        return true;
+      }
     }
-    f_info->file = file;
-    f_info->read_bytes = page_read_bytes;
-    f_info->ofs = offset;
+    return false;
+  }
 
-    if (!vm_alloc_page_with_initializer (VM_FILE, addr, writable, lazy_load_segment, f_info)) {
-      return NULL;
+  struct hash_iterator i;
+  hash_first (&i, &spt->spt_hash);
+  while (hash_next (&i)) {
+    void *va = pg_round_down (hash_entry (hash_cur (&i), struct page, h_elem)->va);
+    if (va >= start && va < end) {
+      return true;
     }
+  }
+  return false;
+}
 
-    read_bytes -= page_read_bytes;
-    addr += PGSIZE;
-    offset += page_read_bytes;
-    length -= PGSIZE;
+/* Do the mmap.  Only the area is recorded here, its pages are made by
+ * vm_get_page on first access.  The area takes ownership of FILE. */
+void *
+do_mmap (void *addr, size_t length, int writable, struct file *file, off_t offset) {
+  struct supplemental_page_table *spt = &thread_current ()->spt;
+  void *end = addr + ROUND_UP (length, PGSIZE);
+  off_t file_len = file_length (file);
+  size_t read_bytes = file_len > offset ? (size_t)(file_len - offset) : 0;
+
+  if (end <= addr || !is_user_vaddr (end - 1)
+      || vma_overlaps (&spt->vmas, addr, end)
+      || mmap_range_used (spt, addr, end)) {
+    return NULL;
   }
-  struct page *page = spt_find_page (&thread_current ()->spt, init_addr);
-  page->file_length = init_length;
-  return init_addr;
+  if (!vma_create (&spt->vmas, addr, length, VM_FILE, writable, file, offset,
+        read_bytes < length ? read_bytes : length)) {
+    return NULL;
+  }
+  return addr;
 }
 
 /* Do the munmap */
 void
 do_munmap (void *addr) {
-  struct thread *curr = thread_current ();
-  struct page *page = spt_find_page (&curr->spt, addr);
+  struct supplemental_page_table *spt = &thread_current ()->spt;
+  struct vma *vma = vma_find (&spt->vmas, addr);
 
-  uint32_t rep = (page->file_length % PGSIZE) == 0
-    ? page->file_length / PGSIZE
-    : (page->file_length / PGSIZE) + 1;
+  if (vma == NULL || vma->start != addr || vma->type != VM_FILE) {
+    return;
+  }
 
-  while (rep--) {
-    hash_delete (&curr->spt.spt_hash, &page->h_elem);
+  /* Only the pages that were touched exist. */
+  while (!list_empty (&vma->pages)) {
+    struct page *page = list_entry (list_pop_front (&vma->pages), struct page, v_elem);
+    lock_acquire (&spt->lock);
+    hash_delete (&spt->spt_hash, &page->h_elem);
+    lock_release (&spt->lock);
     vm_dealloc_page (page);
-
-    addr += PGSIZE;
-    page = spt_find_page (&curr->spt, addr);
   }
-}
\ No newline at end of file
+  vma_remove (&spt->vmas, vma);
+}
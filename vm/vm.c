@@ -14,6 +14,64 @@
 #include "userprog/syscall.h"
 /* ----------------------- */
 
+/* ------ Project 3 : Frame Table ------ */
+/* Every frame that currently backs a user page lives on FRAMES, which is
+ * treated as a ring.  HAND is the clock hand: the next frame that the
+ * replacement policy will examine.  A null HAND means "start of the ring". */
+struct frame_table {
+  struct list frames;
+  struct list_elem *hand;
+  size_t frame_cnt;
+  struct lock lock;
+  struct condition evict_done;  /* Signaled when an eviction finishes. */
+};
+
+static struct frame_table frame_table;
+
+/* Eviction statistics. */
+static long long evict_cnt;        /* # of frames evicted. */
+static long long evict_clean_cnt;  /* # of evictions that needed no write-back. */
+static long long clock_step_cnt;   /* # of frames examined by the clock hand. */
+static long long cow_copy_cnt;     /* # of frames copied on a write fault. */
+
+/* ------ Project 3 : Page-out Daemon ------ */
+/* When the free user pages drop below the low watermark, pageoutd is woken
+ * and evicts frames until the high watermark is reached again, so that
+ * faulting threads normally find a free page without waiting on swap.
+ * Set with -lwm and -hwm. A low watermark of 0 disables the daemon. */
+size_t vm_low_watermark = 32;
+size_t vm_high_watermark = 64;
+
+static struct semaphore pageout_sema;   /* Up'd to wake pageoutd. */
+static bool pageout_wanted;             /* Wake-up pending or running. */
+static long long pageout_cnt;           /* # of frames freed by pageoutd. */
+
+/* ------ Project 3 : Fault-around ------ */
+/* A fault on a lazily loaded file page also loads the adjacent pages that
+ * follow it in the same file, with one file read.  The window starts at a
+ * single page and doubles, up to FAULT_AROUND_MAX, each time a fault lands
+ * right after the previous window; any other fault resets it. */
+#define FAULT_AROUND_MAX 16
+
+static long long fault_around_cnt;      /* # of pages loaded ahead of a fault. */
+
+static bool vm_fault_around (struct page *page);
+
+/* ------ Project 3 : Zero Frame ------ */
+/* Reading an anonymous page that has never been written maps it read-only
+ * on one shared frame of zeros; the first write then takes the normal
+ * copy-on-write path.  The frame is never on the clock ring, and the
+ * reference taken in vm_init keeps ref_cnt above 1 so that a write always
+ * gets a private copy. */
+static struct frame zero_frame;
+static long long zero_map_cnt;          /* # of read faults served by it. */
+
+static bool page_is_zero_fill (struct page *page);
+static bool vm_map_zero_page (struct page *page);
+
+static void pageout_daemon (void *aux);
+static void pageout_wakeup (void);
+
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
 void
@@ -22,15 +80,32 @@ vm_init (void) {
 	vm_file_init ();
 
   /* ------ Project 3 ------ */
-  list_init (&framelist);
-  lock_init (&spt_lock);
+  list_init (&frame_table.frames);
+  frame_table.hand = NULL;
+  frame_table.frame_cnt = 0;
+  lock_init (&frame_table.lock);
+  cond_init (&frame_table.evict_done);
+  zero_frame.kva = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  list_init (&zero_frame.pages);
+  zero_frame.ref_cnt = 1;
 
-#ifdef EFILESYS  /* For project 4 */
-	pagecache_init ();
-#endif
 	register_inspect_intr ();
 	/* DO NOT MODIFY UPPER LINES. */
 	/* TODO: Your code goes here. */
+
+  /* The user pool is still untouched, keep the watermarks well inside it. */
+  size_t user_pages = palloc_user_free_cnt ();
+  if (vm_high_watermark > user_pages / 8) {
+    vm_high_watermark = user_pages / 8;
+  }
+  if (vm_low_watermark > vm_high_watermark) {
+    vm_low_watermark = vm_high_watermark;
+  }
+  sema_init (&pageout_sema, 0);
+  pageout_wanted = false;
+  if (vm_low_watermark > 0) {
+    thread_create ("pageoutd", PRI_DEFAULT, pageout_daemon, NULL);
+  }
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -51,6 +126,7 @@ page_get_type (struct page *page) {
 static struct frame *vm_get_victim    (void);
 static bool          vm_do_claim_page (struct page *page);
 static struct frame *vm_evict_frame   (void);
+static file_info    *vma_page_aux     (struct vma *vma, void *upage);
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
@@ -61,8 +137,19 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable, v
   struct supplemental_page_table *spt = &thread_current ()->spt;
 
 	/* Check wheter the upage is already occupied or not. */
-	if (spt_find_page (spt, upage) == NULL) {
+	if (page_lookup (upage, spt) == NULL) {
     struct page *n_page = malloc (sizeof(struct page));
+    struct vma *vma = vma_find (&spt->vmas, upage);
+
+    if (n_page == NULL) {
+      return false;
+    }
+
+    /* A page made inside an area (e.g. by fork) reads back from the
+     * area's file when no other source is given. */
+    if (vma && aux == NULL) {
+      aux = vma_page_aux (vma, upage);
+    }
 
     if (writable) {
       upage = (void *)((uint64_t)upage | PTE_W);
@@ -82,10 +169,16 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable, v
       default:
         break;
     }
+    n_page->owner = thread_current ();
 
     if (!spt_insert_page(spt, n_page)) {
+      free (n_page);
       return false;
     }
+    if (vma) {
+      n_page->vma = vma;
+      list_push_back (&vma->pages, &n_page->v_elem);
+    }
   }
   else {
     return false;
@@ -94,57 +187,331 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable, v
   return true;
 }
 
-/* Find VA from spt and return page. On error, return NULL. */
+/* Describe the part of VMA's file that backs UPAGE. */
+static file_info *
+vma_page_aux (struct vma *vma, void *upage) {
+  size_t skip = (uint8_t *)upage - (uint8_t *)vma->start;
+  file_info *f_info = malloc (sizeof (file_info));
+
+  if (f_info) {
+    size_t left = vma->read_bytes > skip ? vma->read_bytes - skip : 0;
+    f_info->file = vma->file;
+    f_info->read_bytes = left < PGSIZE ? left : PGSIZE;
+    f_info->ofs = vma->ofs + skip;
+  }
+  return f_info;
+}
+
+/* Create OWNER's lazy page at UPAGE of VMA on its first use. */
+static struct page *
+vma_page_create (struct thread *owner, struct vma *vma, void *upage) {
+  struct page *page = malloc (sizeof (struct page));
+  file_info *f_info = vma_page_aux (vma, upage);
+  void *va = vma->writable ? (void *)((uint64_t)upage | PTE_W) : upage;
+
+  if (page == NULL || f_info == NULL) {
+    goto fail;
+  }
+  uninit_new (page, va, lazy_load_segment, vma->type, f_info,
+      vma->type == VM_FILE ? file_backed_initializer : anon_initializer);
+  page->owner = owner;
+
+  if (!spt_insert_page (&owner->spt, page)) {
+    goto fail;
+  }
+  page->vma = vma;
+  list_push_back (&vma->pages, &page->v_elem);
+  return page;
+
+fail:
+  free (f_info);
+  free (page);
+  return NULL;
+}
+
+/* Find VA from spt and return page. On error, return NULL.
+ * A page of an area that has not been used yet is not found; see
+ * vm_get_page. */
 struct page *
   spt_find_page (struct supplemental_page_table *spt, void *va) {
-  struct page *page = page_lookup (va, (void *)&spt->spt_hash);
+  struct page *page;
 
+  /* Only the owner changes its table, so it can read without the lock. */
+  if (spt == &thread_current ()->spt) {
+    page = page_lookup (va, spt);
+  }
+  else {
+    lock_acquire (&spt->lock);
+    page = page_lookup (va, spt);
+    lock_release (&spt->lock);
+  }
 	return page;
 }
 
+/* Return OWNER's page at VA, making it on first use if VA lies in one of
+ * OWNER's areas, or NULL if VA is not mapped.  OWNER must be the running
+ * thread: only it changes its table and areas. */
+struct page *
+vm_get_page (struct thread *owner, void *va) {
+  struct page *page;
+
+  ASSERT (owner == thread_current ());
+
+  page = spt_find_page (&owner->spt, va);
+  if (page == NULL) {
+    struct vma *vma = vma_find (&owner->spt.vmas, va);
+    if (vma) {
+      page = vma_page_create (owner, vma, pg_round_down (va));
+    }
+  }
+  return page;
+}
+
 /* Insert PAGE into spt with validation. */
 bool
 spt_insert_page (struct supplemental_page_table *spt, struct page *page) {
-  lock_acquire (&spt_lock);
+  lock_acquire (&spt->lock);
   bool succ = hash_insert (&spt->spt_hash, &page->h_elem) != NULL ? false : true;
-  lock_release (&spt_lock);
+  lock_release (&spt->lock);
   return succ;
 }
 
 void
 spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
-  lock_acquire (&spt_lock);
+  lock_acquire (&spt->lock);
+  hash_delete (&spt->spt_hash, &page->h_elem);
+  if (page->vma) {
+    list_remove (&page->v_elem);
+  }
+  lock_release (&spt->lock);
 	vm_dealloc_page (page);
-  lock_release (&spt_lock);
   return;
 }
 
-/* Get the struct frame, that will be evicted. */
+/* Put FRAME into the clock ring just behind the hand, so that it is the
+ * last frame to be examined and gets a full revolution before eviction.
+ * The caller must hold the frame table lock. */
+static void
+frame_table_insert (struct frame *frame) {
+  if (frame_table.hand == NULL) {
+    list_push_back (&frame_table.frames, &frame->f_elem);
+  }
+  else {
+    list_insert (frame_table.hand, &frame->f_elem);
+  }
+  frame_table.frame_cnt++;
+}
+
+/* Link PAGE to FRAME. The first page attached becomes frame->page. */
+static void
+frame_attach (struct frame *frame, struct page *page) {
+  list_push_back (&frame->pages, &page->s_elem);
+  frame->ref_cnt++;
+  frame->page = list_entry (list_front (&frame->pages), struct page, s_elem);
+  page->frame = frame;
+}
+
+/* Unlink PAGE from FRAME and return the number of pages still sharing it. */
+static int
+frame_detach (struct frame *frame, struct page *page) {
+  list_remove (&page->s_elem);
+  frame->ref_cnt--;
+  frame->page = frame->ref_cnt > 0
+    ? list_entry (list_front (&frame->pages), struct page, s_elem)
+    : NULL;
+  page->frame = NULL;
+  return frame->ref_cnt;
+}
+
+/* Take FRAME off the clock ring.  The caller must hold the frame table lock. */
+static void
+frame_table_remove (struct frame *frame) {
+  if (frame_table.hand == &frame->f_elem) {
+    frame_table.hand = list_next (&frame->f_elem);
+    if (frame_table.hand == list_end (&frame_table.frames)) {
+      frame_table.hand = NULL;
+    }
+  }
+  list_remove (&frame->f_elem);
+  frame_table.frame_cnt--;
+}
+
+/* Return the frame under the clock hand and advance the hand by one,
+ * wrapping around at the end of the ring. */
+static struct frame *
+clock_advance (void) {
+  struct list_elem *e = frame_table.hand;
+
+  if (e == NULL) {
+    e = list_begin (&frame_table.frames);
+  }
+  frame_table.hand = list_next (e);
+  if (frame_table.hand == list_end (&frame_table.frames)) {
+    frame_table.hand = NULL;
+  }
+  clock_step_cnt++;
+
+  return list_entry (e, struct frame, f_elem);
+}
+
+/* A frame counts as referenced if any user mapping of it or the kernel
+ * alias (kva in base_pml4) has its accessed bit set. */
+static bool
+frame_is_accessed (struct frame *frame) {
+  struct list_elem *e;
+
+  for (e = list_begin (&frame->pages); e != list_end (&frame->pages); e = list_next (e)) {
+    struct page *page = list_entry (e, struct page, s_elem);
+    if (pml4_is_accessed (page->owner->pml4, page->va)) {
+      return true;
+    }
+  }
+  return pml4_is_accessed (base_pml4, frame->kva);
+}
+
+static void
+frame_clear_accessed (struct frame *frame) {
+  struct list_elem *e;
+
+  for (e = list_begin (&frame->pages); e != list_end (&frame->pages); e = list_next (e)) {
+    struct page *page = list_entry (e, struct page, s_elem);
+    pml4_set_accessed (page->owner->pml4, page->va, false);
+  }
+  pml4_set_accessed (base_pml4, frame->kva, false);
+}
+
+/* Whether evicting FRAME costs a disk write. Anonymous pages always go to
+ * swap, file-backed pages only when one of the aliases is dirty. */
+static bool
+frame_needs_writeback (struct frame *frame) {
+  struct list_elem *e;
+
+  for (e = list_begin (&frame->pages); e != list_end (&frame->pages); e = list_next (e)) {
+    struct page *page = list_entry (e, struct page, s_elem);
+    if (VM_TYPE (page->operations->type) != VM_FILE
+        || pml4_is_dirty (page->owner->pml4, page->va)) {
+      return true;
+    }
+  }
+  return pml4_is_dirty (base_pml4, frame->kva);
+}
+
+/* Get the struct frame, that will be evicted.
+ * Enhanced second-chance clock. Even passes look for a frame that is neither
+ * referenced nor in need of write-back and leave the bits alone. Odd passes
+ * take any unreferenced frame and clear the accessed bits they pass over.
+ * After one odd pass every frame has lost its reference, so the following
+ * passes are guaranteed to find a victim unless the frames were touched
+ * again in the meantime; in that case fall back to any frame.
+ * A frame shared copy-on-write counts as referenced when any of its pages
+ * is, and is evicted with all of them.
+ * The caller must hold the frame table lock. */
 static struct frame *
 vm_get_victim (void) {
-  struct frame *victim = NULL;
+  if (list_empty (&frame_table.frames)) {
+    return NULL;
+  }
 
-  victim = list_entry (list_front (&framelist), struct frame, f_elem);
-	return victim;
+  for (int pass = 0; pass < 4; pass++) {
+    for (size_t i = 0; i < frame_table.frame_cnt; i++) {
+      struct frame *frame = clock_advance ();
+      bool accessed = frame_is_accessed (frame);
+
+      if (pass % 2 == 0) {
+        if (!accessed && !frame_needs_writeback (frame)) {
+          return frame;
+        }
+      }
+      else {
+        if (!accessed) {
+          return frame;
+        }
+        frame_clear_accessed (frame);
+      }
+    }
+  }
+
+  return clock_advance ();
+}
+
+/* Wait until PAGE is not being evicted.  The caller must hold the frame
+ * table lock. */
+static void
+frame_wait_evict (struct page *page) {
+  while (page->frame != NULL && page->frame->evicting) {
+    cond_wait (&frame_table.evict_done, &frame_table.lock);
+  }
 }
 
-/* Evict one page and return the corresponding frame.
- * Return NULL on error.*/
+/* Evict one frame and return it with no page attached.
+ * Return NULL on error.
+ * The victim is taken off the clock ring and marked evicting under the
+ * frame table lock, but its pages are written out after the lock is
+ * released, so that faults, forks and claims elsewhere are not held up
+ * by the I/O.  Until the eviction finishes the pages stay attached,
+ * and whoever needs one of them waits in frame_wait_evict().
+ * If a page cannot be written out, the pages written before it are
+ * evicted and the others keep the frame, which goes back on the ring. */
 static struct frame *
 vm_evict_frame (void) {
+  lock_acquire (&frame_table.lock);
   struct frame *victim = vm_get_victim ();
 
   if (!victim) {
+    lock_release (&frame_table.lock);
     return NULL;
   }
+  frame_table_remove (victim);
+  victim->evicting = true;
+  bool clean = !frame_needs_writeback (victim);
+  lock_release (&frame_table.lock);
+
+  /* Every page sharing the frame is unmapped and written out on its own;
+   * each comes back in with a private frame. */
+  struct page *failed = NULL;
+  struct list_elem *e;
+  for (e = list_begin (&victim->pages); e != list_end (&victim->pages); e = list_next (e)) {
+    struct page *page = list_entry (e, struct page, s_elem);
+    if (!swap_out (page)) {
+      failed = page;
+      break;
+    }
+  }
 
-  if (!swap_out (victim->page)) {
+  lock_acquire (&frame_table.lock);
+  while (!list_empty (&victim->pages)) {
+    struct page *page = list_entry (list_front (&victim->pages), struct page, s_elem);
+    if (page == failed) {
+      break;
+    }
+    frame_detach (victim, page);
+  }
+  victim->evicting = false;
+  cond_broadcast (&frame_table.evict_done, &frame_table.lock);
+
+  if (failed) {
+    /* Map the page again if its swap_out had unmapped it.  Its page
+     * table already covers the address, so this needs no memory. */
+    void *uaddr = pg_round_down (failed->va);
+    if (pml4_get_page (failed->owner->pml4, uaddr) == NULL) {
+      pml4_set_page (failed->owner->pml4, uaddr, victim->kva,
+          ((uint64_t)failed->va & PTE_W) && victim->ref_cnt == 1);
+    }
+    frame_table_insert (victim);
+    lock_release (&frame_table.lock);
     return NULL;
   }
+  lock_release (&frame_table.lock);
+
+  /* The frame is about to back another page; forget the history of the
+   * kernel alias so it does not leak into the next owner's decisions. */
+  pml4_set_accessed (base_pml4, victim->kva, false);
+  pml4_set_dirty (base_pml4, victim->kva, false);
 
-  list_remove (&victim->f_elem);
-  victim->page->frame = NULL;
-  victim->page = NULL;
+  evict_cnt++;
+  if (clean) {
+    evict_clean_cnt++;
+  }
 
   return victim;
 }
@@ -153,27 +520,103 @@ vm_evict_frame (void) {
   palloc() and get frame. This always return valid address.
   If there is no available page, evict the page and return it.
   That is, if the user pool memory is full, this function evicts the frame to get the available memory space.
+  The frame joins the frame table only once its page is loaded (see vm_do_claim_page),
+  so a half-initialized page is never picked as a victim.
+  The contents are left as they are, callers that do not overwrite the whole
+  frame must clear it.
 */
 static struct frame *
 vm_get_frame (void) {
-  struct frame *frame = (struct frame *)calloc (sizeof(struct frame), 1);
-  if (!frame) {
-    return NULL;
+  struct frame *frame = NULL;
+  void *kva = palloc_get_page (PAL_USER);
+
+  pageout_wakeup ();
+  if (kva) {
+    frame = (struct frame *)calloc (sizeof(struct frame), 1);
+    if (!frame) {
+      palloc_free_page (kva);
+      return NULL;
+    }
+    frame->kva = kva;
+    list_init (&frame->pages);
   }
-  frame->kva = palloc_get_page(PAL_USER | PAL_ZERO);
-
-  if (!frame->kva) {
-    free (frame);
+  else {
     frame = vm_evict_frame ();
+    if (!frame) {
+      return NULL;
+    }
   }
 
-  list_push_back (&framelist, &frame->f_elem);
-
 	ASSERT (frame != NULL);
 	ASSERT (frame->page == NULL);
 	return frame;
 }
 
+/* Wake pageoutd if the user pool is running low. */
+static void
+pageout_wakeup (void) {
+  if (vm_low_watermark == 0 || pageout_wanted) {
+    return;
+  }
+  if (palloc_user_free_cnt () < vm_low_watermark) {
+    pageout_wanted = true;
+    sema_up (&pageout_sema);
+  }
+}
+
+/* Page-out daemon. Writes back and evicts frames picked by the clock until
+ * the high watermark of free user pages is reached, then sleeps. */
+static void
+pageout_daemon (void *aux UNUSED) {
+  while (true) {
+    sema_down (&pageout_sema);
+
+    while (palloc_user_free_cnt () < vm_high_watermark) {
+      struct frame *frame = vm_evict_frame ();
+      if (!frame) {
+        break;
+      }
+      palloc_free_page (frame->kva);
+      free (frame);
+      pageout_cnt++;
+    }
+    pageout_wanted = false;
+  }
+}
+
+/* Detach PAGE from its frame and unmap it. The frame is dropped from the
+ * frame table and released once no other page shares it.  An eviction
+ * of PAGE in progress is waited for, so that afterwards PAGE is either
+ * resident or completely written out. */
+void
+vm_free_frame (struct page *page) {
+  lock_acquire (&frame_table.lock);
+  frame_wait_evict (page);
+  struct frame *frame = page->frame;
+
+  if (frame) {
+    pml4_clear_page (page->owner->pml4, pg_round_down (page->va));
+    if (frame_detach (frame, page) == 0) {
+      frame_table_remove (frame);
+      palloc_free_page (frame->kva);
+      free (frame);
+    }
+  }
+  lock_release (&frame_table.lock);
+}
+
+/* Prints frame eviction statistics. */
+void
+vm_print_stats (void) {
+  printf ("Frame: %lld evictions (%lld clean, %lld dirty), %lld clock steps\n",
+      evict_cnt, evict_clean_cnt, evict_cnt - evict_clean_cnt, clock_step_cnt);
+  printf ("Frame: %lld copy-on-write faults, %lld frames freed by pageoutd\n",
+      cow_copy_cnt, pageout_cnt);
+  printf ("Frame: %lld pages loaded by fault-around, %lld zero-frame mappings\n",
+      fault_around_cnt, zero_map_cnt);
+  swap_print_stats ();
+}
+
 /* Growing the stack. */
 static void
 vm_stack_growth (void *addr) {
@@ -188,9 +631,66 @@ vm_stack_growth (void *addr) {
   }
 }
 
-/*  the fault on write_protected page */
+/* Give PAGE a private, writable frame.  Nothing to copy if PAGE is the
+ * last one left on its frame.  Returns true when the faulting access
+ * can be retried. */
 static bool
-vm_handle_wp (struct page *page UNUSED) {
+vm_handle_wp (struct page *page) {
+  void *uaddr = pg_round_down (page->va);
+  struct frame *frame = NULL;
+
+  if (!((uint64_t)page->va & PTE_W)) {
+    return false;
+  }
+
+  while (true) {
+    lock_acquire (&frame_table.lock);
+    frame_wait_evict (page);
+    struct frame *old = page->frame;
+
+    /* Evicted meanwhile, the retried access will fault it back in. */
+    if (!old) {
+      break;
+    }
+    if (old->ref_cnt == 1) {
+      pml4_set_writable (page->owner->pml4, uaddr, true);
+      break;
+    }
+    if (frame) {
+      if (old == &zero_frame) {
+        memset (frame->kva, 0, PGSIZE);
+      }
+      else {
+        memcpy (frame->kva, old->kva, PGSIZE);
+      }
+      frame_detach (old, page);
+      frame_attach (frame, page);
+      frame_table_insert (frame);
+      pml4_clear_page (page->owner->pml4, uaddr);
+      if (!pml4_set_page (page->owner->pml4, uaddr, frame->kva, true)) {
+        lock_release (&frame_table.lock);
+        return false;
+      }
+      lock_release (&frame_table.lock);
+      cow_copy_cnt++;
+      return true;
+    }
+    lock_release (&frame_table.lock);
+
+    /* vm_get_frame may evict, so it runs without the lock; the state of
+     * PAGE is checked again afterwards. */
+    frame = vm_get_frame ();
+    if (!frame) {
+      return false;
+    }
+  }
+  lock_release (&frame_table.lock);
+
+  if (frame) {
+    palloc_free_page (frame->kva);
+    free (frame);
+  }
+  return true;
 }
 
 /* Return true on success */
@@ -198,11 +698,27 @@ bool
 vm_try_handle_fault (struct intr_frame *f, void *addr, bool user, bool write, bool not_present) {
   uintptr_t rsp = f->rsp;
 
+  /* Write to a present page: copy-on-write or a real protection fault. */
+  if (!not_present) {
+    struct page *page = spt_find_page (&thread_current ()->spt, addr);
+
+    if (!page || !write) {
+      return false;
+    }
+    return vm_handle_wp (page);
+  }
+
   bool addr_in_stack = ((uint64_t)addr >= (rsp - 8)) && (USER_STACK - (uint64_t)addr < (1 << 20));
   if (addr_in_stack) {
     vm_stack_growth (addr);
   }
 
+  if (!write) {
+    struct page *page = vm_get_page (thread_current (), addr);
+    if (page && vm_map_zero_page (page)) {
+      return true;
+    }
+  }
   return vm_claim_page (addr);
 }
 
@@ -217,52 +733,302 @@ vm_dealloc_page (struct page *page) {
 /* Claim the page that allocate on VA. */
 bool
 vm_claim_page (void *va) {
-  struct page *page = spt_find_page (&thread_current()->spt, va);
+  struct page *page = vm_get_page (thread_current (), va);
 
   if (!page) {
     return false;
+  }
+  if (vm_fault_around (page)) {
+    return true;
   }
 	return vm_do_claim_page (page);
 }
 
-/* Claim the PAGE and set up the mmu. */
+/* Claim the PAGE and set up the mmu.
+ * PAGE is attached under the frame table lock.  A page that an eviction
+ * has unmapped stays attached to its old frame until it is written out,
+ * so a fault that races with the eviction waits here and then loads
+ * what the eviction wrote out. */
 static bool
 vm_do_claim_page (struct page *page) {
   struct frame  *frame = vm_get_frame ();
-  struct thread     *t = thread_current ();
+  struct thread     *t = page->owner;
   void *       uaddr = (void *)((uint64_t)page->va & ~PGMASK);
   void *    writable = (void *)((uint64_t)page->va & PTE_W);
 
   if (!frame) {
     return false;
+  }
+  /* Only a page with nothing to load needs a cleared frame. */
+  if (page_is_zero_fill (page) && page->uninit.init == NULL) {
+    memset (frame->kva, 0, PGSIZE);
   }
 	/* Set links */
-	frame->page = page;
-	page->frame = frame;
-
+  lock_acquire (&frame_table.lock);
+  frame_wait_evict (page);
+  if (page->frame != NULL) {
+    /* Claimed by someone else meanwhile. */
+    lock_release (&frame_table.lock);
+    palloc_free_page (frame->kva);
+    free (frame);
+    return true;
+  }
+  frame_attach (frame, page);
+  lock_release (&frame_table.lock);
 
   if (!(pml4_get_page (t->pml4, uaddr) == NULL
     && pml4_set_page (t->pml4, uaddr, frame->kva, writable))) {
+    goto fail;
+  }
+
+  if (!swap_in (page, frame->kva)) {
+    pml4_clear_page (t->pml4, uaddr);
+    goto fail;
+  }
+
+  /* The frame now mirrors its backing store. */
+  pml4_set_dirty (base_pml4, frame->kva, false);
+  lock_acquire (&frame_table.lock);
+  frame_table_insert (frame);
+  lock_release (&frame_table.lock);
+  return true;
+
+fail:
+  lock_acquire (&frame_table.lock);
+  frame_detach (frame, page);
+  lock_release (&frame_table.lock);
+  palloc_free_page (frame->kva);
+  free (frame);
+  return false;
+}
+
+/* Whether PAGE is an anonymous page that has not been loaded yet and
+ * whose contents are all zero. */
+static bool
+page_is_zero_fill (struct page *page) {
+  if (page->operations->type != VM_UNINIT
+      || VM_TYPE (page->uninit.type) != VM_ANON) {
     return false;
   }
+  if (page->uninit.init == NULL) {
+    return true;
+  }
 
-	return swap_in (page, frame->kva);
+  file_info *f_info = page->uninit.aux;
+  return page->uninit.init == lazy_load_segment
+    && f_info != NULL && f_info->read_bytes == 0;
+}
+
+/* Map PAGE read-only on the zero frame if it is an untouched zero-fill
+ * page.  Returns false, having done nothing, otherwise. */
+static bool
+vm_map_zero_page (struct page *page) {
+  void *uaddr = pg_round_down (page->va);
+
+  if (!page_is_zero_fill (page)
+      || !page->uninit.page_initializer (page, page->uninit.type, NULL)) {
+    return false;
+  }
+
+  lock_acquire (&frame_table.lock);
+  frame_attach (&zero_frame, page);
+  bool succ = pml4_set_page (page->owner->pml4, uaddr, zero_frame.kva, false);
+  if (!succ) {
+    frame_detach (&zero_frame, page);
+  }
+  lock_release (&frame_table.lock);
+
+  if (succ) {
+    zero_map_cnt++;
+  }
+  return succ;
+}
+
+/* Whether NEXT holds the file bytes that directly follow those of PREV,
+ * both being pages that still wait for lazy_load_segment. */
+static bool
+fault_around_follows (struct page *prev, struct page *next) {
+  if (next == NULL || next->operations->type != VM_UNINIT
+      || next->uninit.init != lazy_load_segment || next->uninit.aux == NULL
+      || VM_TYPE (next->uninit.type) != VM_TYPE (prev->uninit.type)) {
+    return false;
+  }
+
+  file_info *p_info = prev->uninit.aux;
+  file_info *n_info = next->uninit.aux;
+  return p_info->file == n_info->file
+    && p_info->read_bytes == PGSIZE
+    && n_info->ofs == p_info->ofs + PGSIZE;
+}
+
+/* Load PAGE, a lazy file-backed page, together with the pages that follow
+ * it in the same file.  The run is read with a single file_read_at into
+ * physically contiguous user frames, which are then handed out one per
+ * page.  Returns false, having done nothing, when PAGE is not a candidate,
+ * memory is tight, or the window is a single page; the caller then claims
+ * PAGE the normal way. */
+static bool
+vm_fault_around (struct page *page) {
+  struct supplemental_page_table *spt = &page->owner->spt;
+  void *uaddr = pg_round_down (page->va);
+  struct page *run[FAULT_AROUND_MAX];
+  size_t n = 1;
+
+  if (page->operations->type != VM_UNINIT
+      || page->uninit.init != lazy_load_segment || page->uninit.aux == NULL) {
+    return false;
+  }
+
+  /* Sequential faults grow the window, anything else shrinks it. */
+  if (uaddr == spt->ra_next && spt->ra_window < FAULT_AROUND_MAX) {
+    spt->ra_window *= 2;
+  }
+  else if (uaddr != spt->ra_next) {
+    spt->ra_window = 1;
+  }
+  spt->ra_next = uaddr + PGSIZE;
+
+  /* Reading ahead under memory pressure only evicts useful pages. */
+  if (spt->ra_window < 2 || palloc_user_free_cnt () < vm_high_watermark) {
+    return false;
+  }
+
+  run[0] = page;
+  while (n < spt->ra_window) {
+    struct page *next = vm_get_page (page->owner, uaddr + n * PGSIZE);
+    if (!fault_around_follows (run[n - 1], next)) {
+      break;
+    }
+    run[n++] = next;
+  }
+  spt->ra_next = uaddr + n * PGSIZE;
+  if (n < 2) {
+    return false;
+  }
+
+  uint8_t *kva = palloc_get_multiple (PAL_USER, n);
+  if (kva == NULL) {
+    return false;
+  }
+
+  file_info *first = page->uninit.aux;
+  file_info *last = run[n - 1]->uninit.aux;
+  off_t bytes = (n - 1) * PGSIZE + last->read_bytes;
+  if (file_read_at (first->file, kva, bytes, first->ofs) != bytes) {
+    palloc_free_multiple (kva, n);
+    return false;
+  }
+  memset (kva + bytes, 0, n * PGSIZE - bytes);
+
+  size_t i;
+  for (i = 0; i < n; i++) {
+    struct page *p = run[i];
+    void *writable = (void *)((uint64_t)p->va & PTE_W);
+    struct frame *frame = calloc (sizeof(struct frame), 1);
+
+    /* Out of kernel memory: leave the rest to ordinary faults. */
+    if (!frame) {
+      palloc_free_multiple (kva + i * PGSIZE, n - i);
+      break;
+    }
+    frame->kva = kva + i * PGSIZE;
+    list_init (&frame->pages);
+
+    /* No memory for the page table: the page stays lazy and so do the
+     * rest, ordinary faults load them later.  The page is attached and
+     * joins the ring under the frame table lock, as in
+     * vm_do_claim_page. */
+    lock_acquire (&frame_table.lock);
+    if (p->frame != NULL
+        || !pml4_set_page (p->owner->pml4, pg_round_down (p->va), frame->kva, writable)) {
+      lock_release (&frame_table.lock);
+      free (frame);
+      palloc_free_multiple (kva + i * PGSIZE, n - i);
+      break;
+    }
+    frame_attach (frame, p);
+
+    /* Turn the page into its final type; the contents are already in
+     * place, so the lazy_load_segment initializer is not run. */
+    p->uninit.page_initializer (p, p->uninit.type, frame->kva);
+    pml4_set_dirty (base_pml4, frame->kva, false);
+    frame_table_insert (frame);
+    lock_release (&frame_table.lock);
+  }
+  if (i > 0) {
+    fault_around_cnt += i - 1;
+  }
+
+  return page->frame != NULL;
+}
+
+/* Map the frame of PARENT, a page of the parent process, into the child
+ * page PAGE read-only and write-protect the parent's mapping as well.
+ * Whoever writes first gets a private copy in vm_handle_wp.  A parent page
+ * that is currently swapped out is brought back in first. */
+static bool
+vm_share_page (struct page *page, struct page *parent) {
+  void *uaddr = pg_round_down (page->va);
+
+  /* Turn the child's page into its final type without running the
+   * initializer, its contents come from the shared frame. */
+  if (!page->uninit.page_initializer (page, page->uninit.type, NULL)) {
+    return false;
+  }
+
+  while (true) {
+    lock_acquire (&frame_table.lock);
+    frame_wait_evict (parent);
+    struct frame *frame = parent->frame;
+
+    if (frame) {
+      bool succ = pml4_set_page (page->owner->pml4, uaddr, frame->kva, false);
+      if (succ) {
+        frame_attach (frame, page);
+        pml4_set_writable (parent->owner->pml4, pg_round_down (parent->va), false);
+      }
+      lock_release (&frame_table.lock);
+      return succ;
+    }
+    lock_release (&frame_table.lock);
+
+    if (!vm_do_claim_page (parent)) {
+      return false;
+    }
+  }
 }
 
 /* Initialize new supplemental page table */
 void
 supplemental_page_table_init (struct supplemental_page_table *spt) {
   hash_init (&spt->spt_hash, (void *)page_hash, page_less, NULL);
+  lock_init (&spt->lock);
+  vma_table_init (&spt->vmas);
+  spt->ra_next = NULL;
+  spt->ra_window = 1;
+  spt->swap_next = SIZE_MAX;
 }
 
 /* Copy supplemental page table from src to dst */
 
+/* State of one supplemental_page_table_copy.  SUCCESS turns false at the
+ * first page that cannot be copied; the remaining pages are skipped. */
+struct spt_copy {
+  struct supplemental_page_table *dst;
+  bool success;
+};
+
 static void
 hash_page_copy (struct hash_elem *e, void *aux) {
-  struct supplemental_page_table *dst = aux;
+  struct spt_copy                *copy = aux;
+  struct supplemental_page_table  *dst = copy->dst;
   struct page            *parent_page = hash_entry(e, struct page, h_elem);
   enum vm_type                vm_type = page_get_type (parent_page);
-  uint64_t                   writable = (uint64_t)parent_page & PTE_W;
+  uint64_t                   writable = (uint64_t)parent_page->va & PTE_W;
+
+  if (!copy->success) {
+    return;
+  }
 
   switch (parent_page->operations->type) {
     struct page    *child_page;
@@ -270,30 +1036,39 @@ hash_page_copy (struct hash_elem *e, void *aux) {
     void           *child_init;
 
     case VM_UNINIT:
-      child_aux = malloc (sizeof(file_info));
-
-      if (child_aux == NULL) {
-        return;
+      /* The child's copy of the area makes this page again on demand. */
+      if (parent_page->vma) {
+        break;
+      }
+      child_aux = NULL;
+      if (parent_page->uninit.aux) {
+        child_aux = malloc (sizeof(file_info));
+
+        if (child_aux == NULL) {
+          copy->success = false;
+          return;
+        }
+        memcpy (child_aux, parent_page->uninit.aux, sizeof(file_info));
       }
-      memcpy (child_aux, parent_page->uninit.aux, sizeof(file_info));
       child_init = parent_page->uninit.init;
       child_page = parent_page->va;
 
-      vm_alloc_page_with_initializer (vm_type, child_page, writable, child_init, child_aux);
+      if (!vm_alloc_page_with_initializer (vm_type, child_page, writable, child_init, child_aux)) {
+        free (child_aux);
+        copy->success = false;
+      }
       break;
 
     case VM_ANON:
-      vm_alloc_page (vm_type, parent_page->va, writable);
-      child_page = spt_find_page (dst, parent_page->va);
-      vm_do_claim_page (child_page);
-      memcpy (child_page->frame->kva, parent_page->frame->kva, PGSIZE);
-      break;
-
     case VM_FILE:
-      vm_alloc_page (vm_type, parent_page->va, writable);
+      if (!vm_alloc_page (vm_type, parent_page->va, writable)) {
+        copy->success = false;
+        break;
+      }
       child_page = spt_find_page (dst, parent_page->va);
-      vm_do_claim_page (child_page);
-      memcpy (child_page->frame->kva, parent_page->frame->kva, PGSIZE);
+      if (child_page == NULL || !vm_share_page (child_page, parent_page)) {
+        copy->success = false;
+      }
       break;
 
     default:
@@ -308,11 +1083,19 @@ supplemental_page_table_copy (struct supplemental_page_table *dst, struct supple
   dst->spt_hash.hash = src->spt_hash.hash;
   dst->spt_hash.less = src->spt_hash.less;
 
+  if (!vma_table_copy (&dst->vmas, &src->vmas)) {
+    return false;
+  }
+
   //* 부모의 해시 페이지를 자식의 해시 테이블에 복사 - hash_apply
-  src->spt_hash.aux = dst;
+  struct spt_copy copy = { .dst = dst, .success = true };
+  lock_acquire (&src->lock);
+  src->spt_hash.aux = &copy;
   hash_apply (&src->spt_hash, hash_page_copy);
+  src->spt_hash.aux = NULL;
+  lock_release (&src->lock);
 
-  return true;
+  return copy.success;
 }
 
 static void
@@ -335,7 +1118,10 @@ file_munmap (struct hash_elem *e, void *aux) {
 void
 supplemental_page_table_kill (struct supplemental_page_table *spt) {
   // print_spt ();
+  lock_acquire (&spt->lock);
   hash_clear (&spt->spt_hash, hash_page_kill);
+  lock_release (&spt->lock);
+  vma_table_kill (&spt->vmas);
 }
 
 unsigned
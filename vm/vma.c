@@ -0,0 +1,158 @@
+/* vma.c: Per-process table of virtual memory areas (mmap and ELF segments). */
+
+#include "vm/vm.h"
+#include <round.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+
+static bool vma_insert (struct vma_table *vt, struct vma *vma);
+
+void
+vma_table_init (struct vma_table *vt) {
+  vt->areas = NULL;
+  vt->cnt = 0;
+  vt->cap = 0;
+}
+
+/* Number of areas whose start is at or below VA, i.e. the index just past
+ * the only area that can contain VA. */
+static size_t
+vma_upper_bound (struct vma_table *vt, const void *va) {
+  size_t lo = 0, hi = vt->cnt;
+
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (vt->areas[mid]->start <= va) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/* Returns the area containing VA, or NULL. */
+struct vma *
+vma_find (struct vma_table *vt, const void *va) {
+  size_t idx = vma_upper_bound (vt, va);
+
+  if (idx == 0) {
+    return NULL;
+  }
+  struct vma *vma = vt->areas[idx - 1];
+  return va < vma->end ? vma : NULL;
+}
+
+/* Whether any area intersects [START, END). */
+bool
+vma_overlaps (struct vma_table *vt, const void *start, const void *end) {
+  size_t idx = vma_upper_bound (vt, (uint8_t *)end - 1);
+
+  return idx > 0 && vt->areas[idx - 1]->end > start;
+}
+
+static bool
+vma_insert (struct vma_table *vt, struct vma *vma) {
+  if (vt->cnt == vt->cap) {
+    size_t cap = vt->cap ? vt->cap * 2 : 8;
+    struct vma **areas = realloc (vt->areas, cap * sizeof *areas);
+    if (areas == NULL) {
+      return false;
+    }
+    vt->areas = areas;
+    vt->cap = cap;
+  }
+
+  size_t idx = vma_upper_bound (vt, vma->start);
+  memmove (&vt->areas[idx + 1], &vt->areas[idx],
+      (vt->cnt - idx) * sizeof *vt->areas);
+  vt->areas[idx] = vma;
+  vt->cnt++;
+  return true;
+}
+
+/* Record the area of LENGTH bytes (rounded up to pages) at START, whose
+ * first READ_BYTES bytes come from FILE at offset OFS.  The area takes
+ * ownership of FILE.  Returns NULL if the range overlaps another area or
+ * memory is exhausted. */
+struct vma *
+vma_create (struct vma_table *vt, void *start, size_t length,
+    enum vm_type type, bool writable, struct file *file, off_t ofs,
+    size_t read_bytes) {
+  void *end = (uint8_t *)start + ROUND_UP (length, PGSIZE);
+
+  ASSERT (pg_ofs (start) == 0);
+  if (length == 0 || vma_overlaps (vt, start, end)) {
+    return NULL;
+  }
+
+  struct vma *vma = malloc (sizeof *vma);
+  if (vma == NULL) {
+    return NULL;
+  }
+  *vma = (struct vma) {
+    .start = start,
+    .end = end,
+    .type = type,
+    .writable = writable,
+    .file = file,
+    .ofs = ofs,
+    .read_bytes = read_bytes,
+  };
+  list_init (&vma->pages);
+
+  if (!vma_insert (vt, vma)) {
+    free (vma);
+    return NULL;
+  }
+  return vma;
+}
+
+/* Drop VMA from the table, close its file and free it. The pages of the
+ * area must already be gone. */
+void
+vma_remove (struct vma_table *vt, struct vma *vma) {
+  size_t idx = vma_upper_bound (vt, vma->start) - 1;
+
+  ASSERT (vt->areas[idx] == vma);
+  memmove (&vt->areas[idx], &vt->areas[idx + 1],
+      (vt->cnt - idx - 1) * sizeof *vt->areas);
+  vt->cnt--;
+
+  file_close (vma->file);
+  free (vma);
+}
+
+/* Copy every area of SRC into DST, which must be empty. Each copy gets
+ * its own handle on the file. Pages are not copied. */
+bool
+vma_table_copy (struct vma_table *dst, struct vma_table *src) {
+  for (size_t i = 0; i < src->cnt; i++) {
+    struct vma *s = src->areas[i];
+    struct file *file = file_reopen (s->file);
+
+    if (file == NULL) {
+      return false;
+    }
+    if (!vma_create (dst, s->start, (uint8_t *)s->end - (uint8_t *)s->start,
+          s->type, s->writable, file, s->ofs, s->read_bytes)) {
+      file_close (file);
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Free all areas. Their pages must already be destroyed. */
+void
+vma_table_kill (struct vma_table *vt) {
+  for (size_t i = 0; i < vt->cnt; i++) {
+    file_close (vt->areas[i]->file);
+    free (vt->areas[i]);
+  }
+  free (vt->areas);
+  vma_table_init (vt);
+}
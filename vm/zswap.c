@@ -0,0 +1,338 @@
+/* zswap.c: Compressed in-memory tier in front of the swap disk. */
+
+#include "vm/zswap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* An evicted anonymous page is first offered to the arena, a block of
+ * kernel pages cut into ZSWAP_CHUNK-byte chunks.  A page whose 64-bit
+ * words are all equal (typically zero) costs no chunk at all; any other
+ * page is compressed with a small LZ77 coder and stored in consecutive
+ * chunks.  Pages that do not shrink below ZSWAP_MAX_LEN go to the swap
+ * disk as before.  Set with -zswap.
+ *
+ * Stored pages are kept on an LRU list.  When the arena is full the
+ * swap-out path moves the oldest of them on to the swap disk (see
+ * zswap_writeback_begin) and retries.  An entry being written back is
+ * marked WRITEBACK; loading or freeing it waits until it is on the
+ * disk and then hands its slot to the caller. */
+#define ZSWAP_CHUNK 64
+#define ZSWAP_MAX_LEN (PGSIZE * 3 / 4)
+
+size_t zswap_pages = 64;
+
+static uint8_t *arena;             /* ZSWAP_PAGES contiguous kernel pages. */
+static struct bitmap *arena_map;   /* One bit per chunk, true if in use. */
+static struct list lru;            /* Entries in the arena, oldest first. */
+static struct lock zswap_lock;     /* Protects the arena, the LRU list, the
+                                      entries and the scratch buffers. */
+static struct condition writeback_done;  /* An entry left WRITEBACK. */
+
+/* Compressor state, only used under zswap_lock. */
+#define HASH_BITS 12
+static uint16_t hash_table[1 << HASH_BITS];  /* Last position + 1 per hash. */
+static uint8_t scratch[ZSWAP_MAX_LEN];
+
+/* Statistics. */
+static long long store_cnt;        /* # of pages compressed into the arena. */
+static long long same_cnt;         /* # of those that were same-filled. */
+static long long reject_cnt;       /* # of pages that did not compress. */
+static long long hit_cnt;          /* # of swap-ins served from the arena. */
+static long long miss_cnt;         /* # of swap-ins read from the disk. */
+static long long writeback_cnt;    /* # of pages moved on to the disk. */
+static long long bytes_in;         /* Page bytes stored in the arena. */
+static long long bytes_out;        /* Compressed bytes stored for them. */
+
+void
+zswap_init (void) {
+  lock_init (&zswap_lock);
+  cond_init (&writeback_done);
+  list_init (&lru);
+  if (zswap_pages == 0) {
+    return;
+  }
+
+  arena = palloc_get_multiple (0, zswap_pages);
+  arena_map = arena ? bitmap_create (zswap_pages * PGSIZE / ZSWAP_CHUNK) : NULL;
+  if (arena_map == NULL) {
+    if (arena) {
+      palloc_free_multiple (arena, zswap_pages);
+    }
+    arena = NULL;
+    zswap_pages = 0;
+  }
+}
+
+/* Returns true and sets *FILL if the page at KVA repeats one word. */
+static bool
+same_filled (const void *kva, uint64_t *fill) {
+  const uint64_t *w = kva;
+
+  for (size_t i = 1; i < PGSIZE / sizeof *w; i++) {
+    if (w[i] != w[0]) {
+      return false;
+    }
+  }
+  *fill = w[0];
+  return true;
+}
+
+static inline unsigned
+hash3 (const uint8_t *p) {
+  uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+  return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/* Compress the page at SRC into scratch.  The output is a sequence of
+ * control bytes: C < 0x80 is followed by C + 1 literal bytes, C >= 0x80
+ * is a match of (C & 0x7f) + 3 bytes at the 16-bit distance that follows.
+ * Returns the output length, or 0 if it would not fit in ZSWAP_MAX_LEN. */
+static size_t
+lz_compress (const uint8_t *src) {
+  size_t in = 0, lit = 0, out = 0;
+
+  memset (hash_table, 0, sizeof hash_table);
+  while (in + 3 <= PGSIZE) {
+    unsigned h = hash3 (src + in);
+    size_t cand = hash_table[h];
+    hash_table[h] = in + 1;
+
+    if (cand == 0 || memcmp (src + cand - 1, src + in, 3)) {
+      in++;
+      continue;
+    }
+    cand--;
+
+    size_t len = 3;
+    while (len < 130 && in + len < PGSIZE && src[cand + len] == src[in + len]) {
+      len++;
+    }
+
+    /* Literals before the match, then the match. */
+    while (lit < in) {
+      size_t run = in - lit < 128 ? in - lit : 128;
+      if (out + 1 + run > ZSWAP_MAX_LEN) {
+        return 0;
+      }
+      scratch[out++] = run - 1;
+      memcpy (scratch + out, src + lit, run);
+      out += run;
+      lit += run;
+    }
+    if (out + 3 > ZSWAP_MAX_LEN) {
+      return 0;
+    }
+    size_t dist = in - cand;
+    scratch[out++] = 0x80 | (len - 3);
+    scratch[out++] = dist & 0xff;
+    scratch[out++] = dist >> 8;
+    in += len;
+    lit = in;
+  }
+
+  while (lit < PGSIZE) {
+    size_t run = PGSIZE - lit < 128 ? PGSIZE - lit : 128;
+    if (out + 1 + run > ZSWAP_MAX_LEN) {
+      return 0;
+    }
+    scratch[out++] = run - 1;
+    memcpy (scratch + out, src + lit, run);
+    out += run;
+    lit += run;
+  }
+  return out;
+}
+
+/* Expand LEN bytes produced by lz_compress at SRC into the page DST. */
+static void
+lz_decompress (const uint8_t *src, size_t len, uint8_t *dst) {
+  size_t in = 0, out = 0;
+
+  while (in < len) {
+    uint8_t c = src[in++];
+
+    if (c < 0x80) {
+      memcpy (dst + out, src + in, c + 1);
+      in += c + 1;
+      out += c + 1;
+    }
+    else {
+      size_t mlen = (c & 0x7f) + 3;
+      size_t dist = src[in] | (src[in + 1] << 8);
+      in += 2;
+      /* Byte by byte, the match may overlap its own output. */
+      for (size_t i = 0; i < mlen; i++, out++) {
+        dst[out] = dst[out - dist];
+      }
+    }
+  }
+  ASSERT (out == PGSIZE);
+}
+
+/* Try to keep the page at KVA in memory.  Returns ZSWAP_STORED and
+ * fills ENTRY on success. */
+enum zswap_result
+zswap_store (const void *kva, struct zswap_entry *entry) {
+  uint64_t fill;
+
+  if (arena == NULL) {
+    return ZSWAP_REJECTED;
+  }
+  if (same_filled (kva, &fill)) {
+    lock_acquire (&zswap_lock);
+    *entry = (struct zswap_entry) { .chunk = ZSWAP_SAME, .len = 0, .fill = fill };
+    store_cnt++;
+    same_cnt++;
+    bytes_in += PGSIZE;
+    lock_release (&zswap_lock);
+    return ZSWAP_STORED;
+  }
+
+  lock_acquire (&zswap_lock);
+  size_t len = lz_compress (kva);
+  if (len == 0) {
+    reject_cnt++;
+    lock_release (&zswap_lock);
+    return ZSWAP_REJECTED;
+  }
+  size_t chunk = bitmap_scan_and_flip (arena_map, 0,
+      DIV_ROUND_UP (len, ZSWAP_CHUNK), false);
+  if (chunk == BITMAP_ERROR) {
+    lock_release (&zswap_lock);
+    return ZSWAP_FULL;
+  }
+  memcpy (arena + chunk * ZSWAP_CHUNK, scratch, len);
+  *entry = (struct zswap_entry) { .chunk = chunk, .len = len, .fill = 0 };
+  list_push_back (&lru, &entry->lru_elem);
+  store_cnt++;
+  bytes_in += PGSIZE;
+  bytes_out += len;
+  lock_release (&zswap_lock);
+  return ZSWAP_STORED;
+}
+
+/* Frees the arena chunks of ENTRY.  The caller must hold zswap_lock. */
+static void
+arena_release (struct zswap_entry *entry) {
+  bitmap_set_multiple (arena_map, entry->chunk,
+      DIV_ROUND_UP (entry->len, ZSWAP_CHUNK), false);
+  entry->chunk = ZSWAP_SAME;
+  entry->len = 0;
+}
+
+/* Waits until ENTRY is not being written back.  The caller must hold
+ * zswap_lock. */
+static void
+writeback_wait (struct zswap_entry *entry) {
+  while (entry->writeback) {
+    cond_wait (&writeback_done, &zswap_lock);
+  }
+}
+
+/* Restore the page described by ENTRY into KVA and release its space.
+ * Returns ZSWAP_NO_SLOT, or the swap slot the page has been written
+ * back to, which the caller reads and frees instead. */
+size_t
+zswap_load (struct zswap_entry *entry, void *kva) {
+  lock_acquire (&zswap_lock);
+  writeback_wait (entry);
+  if (entry->chunk == ZSWAP_ON_DISK) {
+    lock_release (&zswap_lock);
+    return entry->slot;
+  }
+  if (entry->chunk >= 0) {
+    /* Owned by us from here on, decompress outside the lock. */
+    list_remove (&entry->lru_elem);
+  }
+  hit_cnt++;
+  lock_release (&zswap_lock);
+
+  if (entry->chunk < 0) {
+    uint64_t *w = kva;
+    for (size_t i = 0; i < PGSIZE / sizeof *w; i++) {
+      w[i] = entry->fill;
+    }
+  }
+  else {
+    lz_decompress (arena + entry->chunk * ZSWAP_CHUNK, entry->len, kva);
+    lock_acquire (&zswap_lock);
+    arena_release (entry);
+    lock_release (&zswap_lock);
+  }
+  return ZSWAP_NO_SLOT;
+}
+
+/* Release the space held by ENTRY without reading it back.  Returns
+ * ZSWAP_NO_SLOT, or the swap slot the page has been written back to,
+ * which the caller frees. */
+size_t
+zswap_free (struct zswap_entry *entry) {
+  size_t slot = ZSWAP_NO_SLOT;
+
+  lock_acquire (&zswap_lock);
+  writeback_wait (entry);
+  if (entry->chunk == ZSWAP_ON_DISK) {
+    slot = entry->slot;
+  }
+  else if (entry->chunk >= 0) {
+    list_remove (&entry->lru_elem);
+    arena_release (entry);
+  }
+  entry->chunk = ZSWAP_SAME;
+  lock_release (&zswap_lock);
+  return slot;
+}
+
+/* Starts moving the least recently stored page out of the arena:
+ * decompresses it into KVA, frees its chunks and marks it WRITEBACK.
+ * The caller writes KVA to a swap slot and passes the entry and slot to
+ * zswap_writeback_end.  Returns NULL if the arena holds no page. */
+struct zswap_entry *
+zswap_writeback_begin (void *kva) {
+  struct zswap_entry *entry = NULL;
+
+  lock_acquire (&zswap_lock);
+  if (!list_empty (&lru)) {
+    entry = list_entry (list_pop_front (&lru), struct zswap_entry, lru_elem);
+    lz_decompress (arena + entry->chunk * ZSWAP_CHUNK, entry->len, kva);
+    arena_release (entry);
+    entry->writeback = true;
+  }
+  lock_release (&zswap_lock);
+  return entry;
+}
+
+/* Finishes zswap_writeback_begin: ENTRY's page is now in SLOT. */
+void
+zswap_writeback_end (struct zswap_entry *entry, size_t slot) {
+  lock_acquire (&zswap_lock);
+  entry->chunk = ZSWAP_ON_DISK;
+  entry->slot = slot;
+  entry->writeback = false;
+  writeback_cnt++;
+  cond_broadcast (&writeback_done, &zswap_lock);
+  lock_release (&zswap_lock);
+}
+
+/* Count a swap-in that had to go to the disk. */
+void
+zswap_note_disk_read (void) {
+  lock_acquire (&zswap_lock);
+  miss_cnt++;
+  lock_release (&zswap_lock);
+}
+
+/* Prints compressed swap statistics. */
+void
+zswap_print_stats (void) {
+  printf ("Zswap: %lld pages stored (%lld same-filled), %lld rejected, "
+      "%lld written back\n", store_cnt, same_cnt, reject_cnt, writeback_cnt);
+  printf ("Zswap: %lld hits, %lld misses, %lld%% compressed size\n",
+      hit_cnt, miss_cnt, bytes_in ? bytes_out * 100 / bytes_in : 0);
+}